@@ -2,10 +2,14 @@
 #define CLIMAP_HEADER_GUARD
 
 #include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <climits>
+#include <cstddef>
+#include <cstdint>
 #include <cstdlib>
 #include <cstring>
+#include <deque>
 #include <initializer_list>
 #include <iostream>
 #include <limits>
@@ -14,6 +18,13 @@
 #include <string>
 #include <type_traits>
 #include <utility>
+#include <vector>
+
+#if defined(__AVX2__)
+    #include <immintrin.h>
+#elif defined(__SSE2__)
+    #include <emmintrin.h>
+#endif
 
 struct CLIMapDT;    // CLIMapDefaultTemplates
 
@@ -53,91 +64,672 @@ const NoArgType noarg{};
 const AnyArgType anyarg{};
 
 constexpr int argmap_return_success(int argc, int args_parsed = 0) { return argc - (1+args_parsed); } // Returns argc for the next argument.
+constexpr int argmap_return_consumed(int argc, int args_consumed) { return argc - args_consumed; }    // For bulk handlers; see climap_bulk.
 constexpr int ARGMAP_EXIT_INVALID_ARG = std::numeric_limits<int>::max();
 constexpr int ARGMAP_EXIT_SUCCESS = 0;
 
-template <typename ArgType = CLIMapDT::ArgType, typename MatchFnType = CLIMapDT::MatchFnType, typename ArgIterator = CLIMapDT::ArgIterator>
-class CLIMap {
-    // Yet to be automatically unit (and regression?) tested. See test/MapTestManual for a manual testing application.
-    friend class CLIMapKeyTester;
+// argc for sources of unknown length, e.g. CLIMapArgStream. Handlers count down from it as usual,
+// and find the end of the arguments by the null argument there, as at argv[argc].
+constexpr int CLIMAP_UNBOUNDED_ARGC = std::numeric_limits<int>::max() - 1;
 
-    private:
-        class CLIMapKey;
+// The most arguments a bulk handler is given at once; see climap_bulk.
+constexpr int CLIMAP_BULK_RUN_LIMIT = 1024;
 
-        using RawPairType = std::pair<CLIMapKey, int (*)(int, ArgIterator)>;
-        using RawMapType = std::initializer_list<RawPairType>;
-        using RawMapCIter = typename RawMapType::const_iterator;
+constexpr const char * CLIMAP_PROFILE_SWITCH = "--climap-profile";
+
+class CLIMapProfiler {
+    // Measures CLIMap's key matching and handler phases; see CLIMapProfile.hpp for the implementation.
+    // Once a profiler is installed, exec_main consumes CLIMAP_PROFILE_SWITCH as its first argument
+    // and activates the profiler for the rest of the process. Phases nest (handlers run nested maps),
+    // and every begin_phase is followed by exactly one of the end functions, on the same thread.
+    public:
+        using HandlerId = void (*)();
+
+        virtual ~CLIMapProfiler() { }
 
-        RawMapType raw_map;
+        virtual void begin_phase() = 0;
+        virtual void end_matching_phase() = 0;
+        virtual void end_handler_phase(HandlerId handler) = 0;
 
-        class RawPairPredArgFtor {  // Pred for find_if, created so that arg can be captured by const reference.
+        class Phase {
+            // Begins a phase, and ends it however its scope is left, so that phases stay paired when
+            // handlers or matching functions throw. A handler's phase is given its handler.
             public:
-                RawPairPredArgFtor(const ArgType& arg_in): arg_cref{arg_in}, match_on_anyarg{true}  { };
-                RawPairPredArgFtor(const ArgType& arg_in, bool match_on_anyarg_in): arg_cref{arg_in}, match_on_anyarg{match_on_anyarg_in} { };
+                explicit Phase(CLIMapProfiler& profiler_in, HandlerId handler_in = nullptr): profiler(profiler_in), handler{handler_in} {
+                    profiler.begin_phase();
+                }
 
-                bool operator()(const RawPairType& raw_pair) {
-                    return raw_pair.first.matches(arg_cref, match_on_anyarg);
+                Phase(const Phase&) = delete;
+                Phase& operator=(const Phase&) = delete;
+
+                ~Phase() {
+                    if (handler == nullptr) {
+                        profiler.end_matching_phase();
+                    } else {
+                        profiler.end_handler_phase(handler);
+                    }
                 }
 
             private:
-                const ArgType& arg_cref;
-                bool match_on_anyarg;
+                CLIMapProfiler& profiler;
+                HandlerId handler;
         };
 
-        RawMapCIter get_match_iter(const ArgType& arg, bool match_on_anyarg = true) const {
-            auto raw_map_cbegin = static_cast<RawMapCIter>(raw_map.begin());
-            auto raw_map_cend = static_cast<RawMapCIter>(raw_map.end());
-            RawPairPredArgFtor pred(arg, match_on_anyarg);
-            return std::find_if(raw_map_cbegin, raw_map_cend, pred);
+        static bool install(CLIMapProfiler * profiler) {
+            installed_slot() = profiler;
+            return true;
+        }
+
+        static void deactivate() {
+            // Stops profiling until CLIMAP_PROFILE_SWITCH is seen again.
+            active_slot().store(nullptr, std::memory_order_relaxed);
         }
 
-        RawMapCIter get_match_iter(NoArgType) const {
-            auto raw_map_cbegin = static_cast<RawMapCIter>(raw_map.begin());
-            auto raw_map_cend = static_cast<RawMapCIter>(raw_map.end());
-            auto pred = [](const RawPairType& raw_pair) { return raw_pair.first.matches(noarg); };
-            return std::find_if(raw_map_cbegin, raw_map_cend, pred);
+        static CLIMapProfiler * active() {
+            return active_slot().load(std::memory_order_relaxed);
         }
-        
-        int exec_base(int argc_caller, ArgIterator argv_caller, int args_to_skip, bool match_on_anyarg_in_loop) const {
-             // Will need bulk testing.
-            int argc_left_or_error = -1;
-
-            if (argc_caller - args_to_skip > 0) {   // argc_caller - args_to_skip <= 0 is domain error, see else.
-                int argc_callee;
-                ArgIterator argv_callee;
-                RawMapCIter match_iter;
-                
-                if (argc_caller - args_to_skip == 1) {  // argv_caller[0] is the argument that triggered the calling function.
-                    argc_callee = 1;                    // argc_caller - args_to_skip == 1 means there are no arguments for callee, bar maybe noarg.
-                    argv_callee = argv_caller;
-                    std::advance(argv_callee, args_to_skip);
-                    match_iter = get_match_iter(noarg);
+
+        template<typename ArgType>
+        static bool activate_on_switch(const ArgType& arg) {
+            CLIMapProfiler * profiler = installed_slot();
+            if (profiler == nullptr || !is_switch(arg)) return false;
+            active_slot().store(profiler, std::memory_order_relaxed);
+            return true;
+        }
+
+    private:
+        static CLIMapProfiler *& installed_slot() {
+            static CLIMapProfiler * installed = nullptr;
+            return installed;
+        }
+
+        static std::atomic<CLIMapProfiler *>& active_slot() {
+            static std::atomic<CLIMapProfiler *> active_profiler{nullptr};
+            return active_profiler;
+        }
+
+        template<typename ArgType>
+        static bool is_switch(const ArgType&) {
+            return false;
+        }
+
+        static bool is_switch(const char * const & arg) {
+            return std::strcmp(arg, CLIMAP_PROFILE_SWITCH) == 0;
+        }
+};
+
+class CLIMapRecorder {
+    // Captures the command lines exec_main processes; see CLIMapRecord.hpp for the implementation.
+    // Only command lines of C strings are recorded.
+    public:
+        virtual ~CLIMapRecorder() { }
+
+        virtual void record(int argc, const char * const * argv, int args_to_skip) = 0;
+
+        static bool install(CLIMapRecorder * recorder) {
+            active_slot().store(recorder, std::memory_order_release);
+            return true;
+        }
+
+        template<typename ArgIterator>
+        static void record_if_active(int argc, ArgIterator argv, int args_to_skip) {
+            record_if_active(argc, argv, args_to_skip, std::is_convertible<ArgIterator, const char * const *>());
+        }
+
+    private:
+        template<typename ArgIterator>
+        static void record_if_active(int, ArgIterator, int, std::false_type) { }
+
+        static void record_if_active(int argc, const char * const * argv, int args_to_skip, std::true_type) {
+            CLIMapRecorder * recorder = active_slot().load(std::memory_order_acquire);
+            if (recorder != nullptr) recorder->record(argc, argv, args_to_skip);
+        }
+
+        static std::atomic<CLIMapRecorder *>& active_slot() {
+            static std::atomic<CLIMapRecorder *> active_recorder{nullptr};
+            return active_recorder;
+        }
+};
+
+inline std::ostream *& climap_captured_output() {
+    // Where climap_cout() writes on this thread instead, while a handler's output is captured, e.g. a
+    // speculative handler's (see CLIMapParallel.hpp) or a pure handler's (see CLIMapResultCache.hpp).
+    static thread_local std::ostream * captured = nullptr;
+    return captured;
+}
+
+inline std::ostream& climap_cout() {
+    // Where handlers write their output, so that it can be captured.
+    std::ostream * captured = climap_captured_output();
+    return captured != nullptr ? *captured : std::cout;
+}
+
+enum class CLIMapOutputFormat {
+    text,       // Handlers' own messages, for people.
+    ndjson,     // One JSON object per record and line; see CLIMapOutput.hpp.
+    binary      // Length prefixed records; see CLIMapOutput.hpp.
+};
+
+class CLIMapOutputWriter {
+    // Writes exec_main's own errors as records, in formats other than text; see CLIMapOutput.hpp,
+    // which installs one, and whose CLIMapOutput writes handlers' results and errors. The format is
+    // set for each call of exec_main, on this thread (or the thread that launched a speculative
+    // handler).
+    public:
+        virtual ~CLIMapOutputWriter() { }
+
+        virtual void write_invalid_argument() = 0;
+        virtual void write_unrecognised_argument(long long index, const char * argument) = 0;    // argument is null unless a C string.
+
+        static bool install(CLIMapOutputWriter * writer) {
+            active_slot().store(writer, std::memory_order_release);
+            return true;
+        }
+
+        static CLIMapOutputWriter * active() {
+            return active_slot().load(std::memory_order_acquire);
+        }
+
+        static CLIMapOutputFormat format() {
+            return format_slot();
+        }
+
+        class Scope {
+            // Sets this thread's format for a call of exec_main.
+            public:
+                explicit Scope(CLIMapOutputFormat format): outer_format{format_slot()} {
+                    if (format != CLIMapOutputFormat::text && active() == nullptr) throw std::invalid_argument("CLIMapOutputFormat::ndjson and binary require CLIMapOutput.hpp.");
+                    format_slot() = format;
+                }
+                ~Scope() { format_slot() = outer_format; }
+                Scope(const Scope&) = delete;
+                Scope& operator=(const Scope&) = delete;
+
+            private:
+                CLIMapOutputFormat outer_format;
+        };
+
+    private:
+        static CLIMapOutputFormat& format_slot() {
+            static thread_local CLIMapOutputFormat format = CLIMapOutputFormat::text;
+            return format;
+        }
+
+        static std::atomic<CLIMapOutputWriter *>& active_slot() {
+            static std::atomic<CLIMapOutputWriter *> active_writer{nullptr};
+            return active_writer;
+        }
+};
+
+struct CLIMapUnmarked {
+    // The marks of a handler no optional header has marked, and the base of those of one that has:
+    // no hooks. A mark hides exec_hook, through which a map with such a handler is executed, or
+    // call_hook, through which the handler is called, with one returning the hook for a given map
+    // type, e.g. climap_speculative (see CLIMapParallel.hpp) and climap_pure (see CLIMapResultCache.hpp),
+    // which combine.
+    template<typename Map>
+    static constexpr std::nullptr_t exec_hook() {
+        return nullptr;
+    }
+
+    template<typename Map>
+    static constexpr std::nullptr_t call_hook() {
+        return nullptr;
+    }
+};
+
+template<typename ArgIterator, typename Marks>
+struct CLIMapMarkedHandler {    // See CLIMapUnmarked.
+    int (*function)(int, ArgIterator);
+};
+
+template<typename ArgIterator>
+struct CLIMapBulkHandler {  // See climap_bulk.
+    int (*function)(int, ArgIterator, int);
+};
+
+template<typename ArgIterator>
+constexpr CLIMapBulkHandler<ArgIterator> climap_bulk(int (*function)(int argc, ArgIterator argv, int run)) {
+    // Marks a handler that takes a run of arguments at once, e.g. {is_positive_integer, climap_bulk(fizzbuzz_calculate_main)}.
+    // Rather than calling it for each argument in turn, dispatch looks ahead and calls it with run
+    // set to the number of arguments from argv[0] that all match its key, as they would were it
+    // called for each, up to CLIMAP_BULK_RUN_LIMIT (a longer run is split over several calls). It
+    // consumes as many as it likes, returning argmap_return_consumed(argc, consumed) or an error as
+    // usual. Each argument is matched once, as dispatch would match it: the run ends unmatched at an
+    // argument matching a raw arg key declared before the handler's, and otherwise at the first
+    // matched to another key, whose match dispatch keeps for when it gets there.
+    return CLIMapBulkHandler<ArgIterator>{function};
+}
+
+enum class CLIMapMatchPolicy {
+    exact,              // Raw arg keys match byte for byte.
+    case_insensitive    // Raw arg keys match after case folding; C string args only, see CLIMapCaseFold.
+};
+
+class CLIMapCaseFold {
+    // Unicode simple case folding (CaseFolding.txt statuses C and S, Unicode 14) of UTF-8 strings.
+    // ASCII is folded 32 (AVX2) or 16 (SSE2) bytes per instruction, falling back to decoding code
+    // points only where there are non-ASCII bytes. Malformed UTF-8 is copied unchanged.
+    public:
+        static std::size_t capacity(std::size_t length) {
+            // Bytes to allow for folding length bytes: a few two byte code points fold to three bytes.
+            return length + length/2 + 1;
+        }
+
+        static std::size_t fold(const char * str, std::size_t length, char * out) {
+            // Writes the folded, null terminated, str to out, and returns its length.
+            std::size_t in = 0, folded_length = 0;
+            while (true) {
+                std::size_t ascii_length = fold_ascii(str + in, length - in, out + folded_length);
+                in += ascii_length;
+                folded_length += ascii_length;
+                if (in == length) break;
+
+                std::uint32_t code_point = 0;
+                std::size_t code_point_length = decode(str + in, length - in, code_point);
+                if (code_point_length == 0) {
+                    out[folded_length++] = str[in++];   // Malformed.
+                    continue;
+                }
+                std::uint32_t folded = fold(code_point);
+                if (folded == code_point) {
+                    std::memcpy(out + folded_length, str + in, code_point_length);
+                    folded_length += code_point_length;
                 } else {
-                    argc_callee = argc_caller - (1+args_to_skip);
-                    argv_callee = argv_caller;
-                    std::advance(argv_callee, 1+args_to_skip);
-                    auto arg = *argv_callee;
-                    match_iter = get_match_iter(arg, true);
+                    folded_length += encode(folded, out + folded_length);
                 }
+                in += code_point_length;
+            }
+            out[folded_length] = '\0';
+            return folded_length;
+        }
+
+        static std::uint32_t fold(std::uint32_t code_point) {
+            const Run * const runs = fold_runs();
+            std::size_t low = 0, high = run_count;  // Finds the last run starting at or before code_point.
+            while (high - low > 1) {
+                std::size_t middle = low + (high - low)/2;
+                if (runs[middle].first <= code_point) {
+                    low = middle;
+                } else {
+                    high = middle;
+                }
+            }
+            const Run& run = runs[low];
+            if (code_point < run.first || code_point > run.last || (code_point - run.first) % run.stride != 0) return code_point;
+            return static_cast<std::uint32_t>(static_cast<std::int32_t>(code_point) + run.delta);
+        }
+
+    private:
+        struct Run {    // Maps first, first + stride, ..., up to last, to themselves plus delta.
+            std::uint32_t first;
+            std::uint32_t last;
+            std::int32_t delta;
+            std::uint32_t stride;
+        };
 
-                argc_left_or_error = argc_callee;   // In case arg has no matching handler function. 
+        static constexpr std::size_t run_count = 202;
 
-                while (match_iter != static_cast<RawMapCIter>(raw_map.end())) {
-                    // Call function matched to the next argument to parse and break if unsuccessful or there are no arguments left to parse.
-                    argc_left_or_error = match_iter->second(argc_callee, argv_callee);
-                    if (argc_left_or_error <= 0 || argc_left_or_error == ARGMAP_EXIT_INVALID_ARG) break;
+        static const Run * fold_runs() {
+            static constexpr Run runs[run_count] = {
+                {0x0041, 0x005A, 32, 1}, {0x00B5, 0x00B5, 775, 1}, {0x00C0, 0x00D6, 32, 1}, {0x00D8, 0x00DE, 32, 1},
+                {0x0100, 0x012E, 1, 2}, {0x0132, 0x0136, 1, 2}, {0x0139, 0x0147, 1, 2}, {0x014A, 0x0176, 1, 2},
+                {0x0178, 0x0178, -121, 1}, {0x0179, 0x017D, 1, 2}, {0x017F, 0x017F, -268, 1}, {0x0181, 0x0181, 210, 1},
+                {0x0182, 0x0184, 1, 2}, {0x0186, 0x0186, 206, 1}, {0x0187, 0x0187, 1, 1}, {0x0189, 0x018A, 205, 1},
+                {0x018B, 0x018B, 1, 1}, {0x018E, 0x018E, 79, 1}, {0x018F, 0x018F, 202, 1}, {0x0190, 0x0190, 203, 1},
+                {0x0191, 0x0191, 1, 1}, {0x0193, 0x0193, 205, 1}, {0x0194, 0x0194, 207, 1}, {0x0196, 0x0196, 211, 1},
+                {0x0197, 0x0197, 209, 1}, {0x0198, 0x0198, 1, 1}, {0x019C, 0x019C, 211, 1}, {0x019D, 0x019D, 213, 1},
+                {0x019F, 0x019F, 214, 1}, {0x01A0, 0x01A4, 1, 2}, {0x01A6, 0x01A6, 218, 1}, {0x01A7, 0x01A7, 1, 1},
+                {0x01A9, 0x01A9, 218, 1}, {0x01AC, 0x01AC, 1, 1}, {0x01AE, 0x01AE, 218, 1}, {0x01AF, 0x01AF, 1, 1},
+                {0x01B1, 0x01B2, 217, 1}, {0x01B3, 0x01B5, 1, 2}, {0x01B7, 0x01B7, 219, 1}, {0x01B8, 0x01B8, 1, 1},
+                {0x01BC, 0x01BC, 1, 1}, {0x01C4, 0x01C4, 2, 1}, {0x01C5, 0x01C5, 1, 1}, {0x01C7, 0x01C7, 2, 1},
+                {0x01C8, 0x01C8, 1, 1}, {0x01CA, 0x01CA, 2, 1}, {0x01CB, 0x01DB, 1, 2}, {0x01DE, 0x01EE, 1, 2},
+                {0x01F1, 0x01F1, 2, 1}, {0x01F2, 0x01F4, 1, 2}, {0x01F6, 0x01F6, -97, 1}, {0x01F7, 0x01F7, -56, 1},
+                {0x01F8, 0x021E, 1, 2}, {0x0220, 0x0220, -130, 1}, {0x0222, 0x0232, 1, 2}, {0x023A, 0x023A, 10795, 1},
+                {0x023B, 0x023B, 1, 1}, {0x023D, 0x023D, -163, 1}, {0x023E, 0x023E, 10792, 1}, {0x0241, 0x0241, 1, 1},
+                {0x0243, 0x0243, -195, 1}, {0x0244, 0x0244, 69, 1}, {0x0245, 0x0245, 71, 1}, {0x0246, 0x024E, 1, 2},
+                {0x0345, 0x0345, 116, 1}, {0x0370, 0x0372, 1, 2}, {0x0376, 0x0376, 1, 1}, {0x037F, 0x037F, 116, 1},
+                {0x0386, 0x0386, 38, 1}, {0x0388, 0x038A, 37, 1}, {0x038C, 0x038C, 64, 1}, {0x038E, 0x038F, 63, 1},
+                {0x0391, 0x03A1, 32, 1}, {0x03A3, 0x03AB, 32, 1}, {0x03C2, 0x03C2, 1, 1}, {0x03CF, 0x03CF, 8, 1},
+                {0x03D0, 0x03D0, -30, 1}, {0x03D1, 0x03D1, -25, 1}, {0x03D5, 0x03D5, -15, 1}, {0x03D6, 0x03D6, -22, 1},
+                {0x03D8, 0x03EE, 1, 2}, {0x03F0, 0x03F0, -54, 1}, {0x03F1, 0x03F1, -48, 1}, {0x03F4, 0x03F4, -60, 1},
+                {0x03F5, 0x03F5, -64, 1}, {0x03F7, 0x03F7, 1, 1}, {0x03F9, 0x03F9, -7, 1}, {0x03FA, 0x03FA, 1, 1},
+                {0x03FD, 0x03FF, -130, 1}, {0x0400, 0x040F, 80, 1}, {0x0410, 0x042F, 32, 1}, {0x0460, 0x0480, 1, 2},
+                {0x048A, 0x04BE, 1, 2}, {0x04C0, 0x04C0, 15, 1}, {0x04C1, 0x04CD, 1, 2}, {0x04D0, 0x052E, 1, 2},
+                {0x0531, 0x0556, 48, 1}, {0x10A0, 0x10C5, 7264, 1}, {0x10C7, 0x10C7, 7264, 1}, {0x10CD, 0x10CD, 7264, 1},
+                {0x13F8, 0x13FD, -8, 1}, {0x1C80, 0x1C80, -6222, 1}, {0x1C81, 0x1C81, -6221, 1}, {0x1C82, 0x1C82, -6212, 1},
+                {0x1C83, 0x1C84, -6210, 1}, {0x1C85, 0x1C85, -6211, 1}, {0x1C86, 0x1C86, -6204, 1}, {0x1C87, 0x1C87, -6180, 1},
+                {0x1C88, 0x1C88, 35267, 1}, {0x1C90, 0x1CBA, -3008, 1}, {0x1CBD, 0x1CBF, -3008, 1}, {0x1E00, 0x1E94, 1, 2},
+                {0x1E9B, 0x1E9B, -58, 1}, {0x1E9E, 0x1E9E, -7615, 1}, {0x1EA0, 0x1EFE, 1, 2}, {0x1F08, 0x1F0F, -8, 1},
+                {0x1F18, 0x1F1D, -8, 1}, {0x1F28, 0x1F2F, -8, 1}, {0x1F38, 0x1F3F, -8, 1}, {0x1F48, 0x1F4D, -8, 1},
+                {0x1F59, 0x1F5F, -8, 2}, {0x1F68, 0x1F6F, -8, 1}, {0x1F88, 0x1F8F, -8, 1}, {0x1F98, 0x1F9F, -8, 1},
+                {0x1FA8, 0x1FAF, -8, 1}, {0x1FB8, 0x1FB9, -8, 1}, {0x1FBA, 0x1FBB, -74, 1}, {0x1FBC, 0x1FBC, -9, 1},
+                {0x1FBE, 0x1FBE, -7173, 1}, {0x1FC8, 0x1FCB, -86, 1}, {0x1FCC, 0x1FCC, -9, 1}, {0x1FD8, 0x1FD9, -8, 1},
+                {0x1FDA, 0x1FDB, -100, 1}, {0x1FE8, 0x1FE9, -8, 1}, {0x1FEA, 0x1FEB, -112, 1}, {0x1FEC, 0x1FEC, -7, 1},
+                {0x1FF8, 0x1FF9, -128, 1}, {0x1FFA, 0x1FFB, -126, 1}, {0x1FFC, 0x1FFC, -9, 1}, {0x2126, 0x2126, -7517, 1},
+                {0x212A, 0x212A, -8383, 1}, {0x212B, 0x212B, -8262, 1}, {0x2132, 0x2132, 28, 1}, {0x2160, 0x216F, 16, 1},
+                {0x2183, 0x2183, 1, 1}, {0x24B6, 0x24CF, 26, 1}, {0x2C00, 0x2C2F, 48, 1}, {0x2C60, 0x2C60, 1, 1},
+                {0x2C62, 0x2C62, -10743, 1}, {0x2C63, 0x2C63, -3814, 1}, {0x2C64, 0x2C64, -10727, 1}, {0x2C67, 0x2C6B, 1, 2},
+                {0x2C6D, 0x2C6D, -10780, 1}, {0x2C6E, 0x2C6E, -10749, 1}, {0x2C6F, 0x2C6F, -10783, 1}, {0x2C70, 0x2C70, -10782, 1},
+                {0x2C72, 0x2C72, 1, 1}, {0x2C75, 0x2C75, 1, 1}, {0x2C7E, 0x2C7F, -10815, 1}, {0x2C80, 0x2CE2, 1, 2},
+                {0x2CEB, 0x2CED, 1, 2}, {0x2CF2, 0x2CF2, 1, 1}, {0xA640, 0xA66C, 1, 2}, {0xA680, 0xA69A, 1, 2},
+                {0xA722, 0xA72E, 1, 2}, {0xA732, 0xA76E, 1, 2}, {0xA779, 0xA77B, 1, 2}, {0xA77D, 0xA77D, -35332, 1},
+                {0xA77E, 0xA786, 1, 2}, {0xA78B, 0xA78B, 1, 1}, {0xA78D, 0xA78D, -42280, 1}, {0xA790, 0xA792, 1, 2},
+                {0xA796, 0xA7A8, 1, 2}, {0xA7AA, 0xA7AA, -42308, 1}, {0xA7AB, 0xA7AB, -42319, 1}, {0xA7AC, 0xA7AC, -42315, 1},
+                {0xA7AD, 0xA7AD, -42305, 1}, {0xA7AE, 0xA7AE, -42308, 1}, {0xA7B0, 0xA7B0, -42258, 1}, {0xA7B1, 0xA7B1, -42282, 1},
+                {0xA7B2, 0xA7B2, -42261, 1}, {0xA7B3, 0xA7B3, 928, 1}, {0xA7B4, 0xA7C2, 1, 2}, {0xA7C4, 0xA7C4, -48, 1},
+                {0xA7C5, 0xA7C5, -42307, 1}, {0xA7C6, 0xA7C6, -35384, 1}, {0xA7C7, 0xA7C9, 1, 2}, {0xA7D0, 0xA7D0, 1, 1},
+                {0xA7D6, 0xA7D8, 1, 2}, {0xA7F5, 0xA7F5, 1, 1}, {0xAB70, 0xABBF, -38864, 1}, {0xFF21, 0xFF3A, 32, 1},
+                {0x10400, 0x10427, 40, 1}, {0x104B0, 0x104D3, 40, 1}, {0x10570, 0x1057A, 39, 1}, {0x1057C, 0x1058A, 39, 1},
+                {0x1058C, 0x10592, 39, 1}, {0x10594, 0x10595, 39, 1}, {0x10C80, 0x10CB2, 64, 1}, {0x118A0, 0x118BF, 32, 1},
+                {0x16E40, 0x16E5F, 32, 1}, {0x1E900, 0x1E921, 34, 1}
+            };
+            return runs;
+        }
 
-                    // Find the next argument to parse (and associated argc), look it up in raw_map and break if no match found.
-                    auto number_of_args_handled = argc_callee - argc_left_or_error; // This is why argc_callee and argc_left_or_error are different variables.
-                    std::advance(argv_callee, number_of_args_handled);
-                    argc_callee = argc_left_or_error;
-                    match_iter = get_match_iter(*argv_callee, match_on_anyarg_in_loop);
+        static std::size_t fold_ascii(const char * str, std::size_t length, char * out) {
+            // Folds the longest ASCII prefix of str to out, and returns its length.
+            std::size_t i = 0;
+            #if defined(__AVX2__)
+                for (; i + 32 <= length; i += 32) {
+                    __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(str + i));
+                    if (_mm256_movemask_epi8(bytes) != 0) break;
+                    __m256i upper = _mm256_and_si256(_mm256_cmpgt_epi8(bytes, _mm256_set1_epi8('A' - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8('Z' + 1), bytes));
+                    _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i), _mm256_or_si256(bytes, _mm256_and_si256(upper, _mm256_set1_epi8(0x20))));
+                }
+            #endif
+            #if defined(__SSE2__)     // Also after AVX2, for the tail.
+                for (; i + 16 <= length; i += 16) {
+                    __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(str + i));
+                    if (_mm_movemask_epi8(bytes) != 0) break;
+                    __m128i upper = _mm_and_si128(_mm_cmpgt_epi8(bytes, _mm_set1_epi8('A' - 1)), _mm_cmplt_epi8(bytes, _mm_set1_epi8('Z' + 1)));
+                    _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), _mm_or_si128(bytes, _mm_and_si128(upper, _mm_set1_epi8(0x20))));
                 }
-                // Loop exits with:
-                //      * argc_left_or_error up-to-date, which is then returned.
-                //      * match_iter indicating no-match (2nd break), or pointing to the pair for the last handling function (value) executed (1st break).
+            #endif
+            for (; i != length && static_cast<unsigned char>(str[i]) < 0x80; ++i) {
+                out[i] = str[i] >= 'A' && str[i] <= 'Z' ? static_cast<char>(str[i] | 0x20) : str[i];
+            }
+            return i;
+        }
 
-            } else {
+        static std::size_t decode(const char * str, std::size_t length, std::uint32_t& code_point) {
+            // Returns the length of the well formed, non-ASCII, code point at str, or 0 if malformed.
+            const unsigned char lead = static_cast<unsigned char>(str[0]);
+            std::size_t code_point_length = lead >= 0xF0 ? 4 : lead >= 0xE0 ? 3 : lead >= 0xC0 ? 2 : 0;
+            if (code_point_length == 0 || code_point_length > length || lead > 0xF4) return 0;
+            code_point = lead & (0x7F >> code_point_length);
+            for (std::size_t i = 1; i != code_point_length; ++i) {
+                const unsigned char continuation = static_cast<unsigned char>(str[i]);
+                if ((continuation & 0xC0) != 0x80) return 0;
+                code_point = (code_point << 6) | (continuation & 0x3F);
+            }
+            static const std::uint32_t shortest[] = {0, 0, 0x80, 0x800, 0x10000};  // Overlong encodings are malformed.
+            if (code_point < shortest[code_point_length] || code_point > 0x10FFFF || (code_point >= 0xD800 && code_point <= 0xDFFF)) return 0;
+            return code_point_length;
+        }
+
+        static std::size_t encode(std::uint32_t code_point, char * out) {
+            if (code_point < 0x80) {
+                out[0] = static_cast<char>(code_point);
+                return 1;
+            }
+            std::size_t code_point_length = code_point < 0x800 ? 2 : code_point < 0x10000 ? 3 : 4;
+            for (std::size_t i = code_point_length - 1; i != 0; --i, code_point >>= 6) out[i] = static_cast<char>(0x80 | (code_point & 0x3F));
+            static const unsigned char lead_marks[] = {0, 0, 0xC0, 0xE0, 0xF0};
+            out[0] = static_cast<char>(lead_marks[code_point_length] | code_point);
+            return code_point_length;
+        }
+};
+
+template<typename ArgType>
+class CLIMapRawArgs;
+
+class CLIMapKeyCounts {
+    // A map's raw arg key hit counts, kept by CLIMapKeyStats (see CLIMapKeyStats.hpp) for maps of C
+    // string args. Once a freeze hook is installed, it is given each map's raw arg keys as they are
+    // frozen, and may reorder them and return counts for the map to find them through, or nullptr.
+    // Counts outlive the maps that point at them.
+    public:
+        using FreezeHook = CLIMapKeyCounts * (*)(CLIMapRawArgs<const char *>& raw_args);
+
+        virtual ~CLIMapKeyCounts() { }
+
+        virtual std::size_t find(const CLIMapRawArgs<const char *>& raw_args, const char * arg) = 0;  // As raw_args.find, counting the hit.
+
+        static bool install(FreezeHook hook) {
+            freeze_hook_slot().store(hook, std::memory_order_release);
+            return true;
+        }
+
+        static FreezeHook freeze_hook() {
+            return freeze_hook_slot().load(std::memory_order_acquire);
+        }
+
+    private:
+        static std::atomic<FreezeHook>& freeze_hook_slot() {
+            static std::atomic<FreezeHook> hook{nullptr};
+            return hook;
+        }
+};
+
+template<typename ArgType>
+class CLIMapRawArgs {
+    // Raw arg keys of a single CLIMap, scanned in declaration order so that the first declared of any
+    // duplicate keys wins. This generic version compares with ==; see the const char * specialisation.
+    public:
+        static constexpr std::size_t npos = std::numeric_limits<std::size_t>::max();
+
+        explicit CLIMapRawArgs(CLIMapMatchPolicy policy = CLIMapMatchPolicy::exact) {
+            if (policy != CLIMapMatchPolicy::exact) throw std::invalid_argument("CLIMapMatchPolicy::case_insensitive requires C string args.");
+        }
+
+        void push_back(const ArgType& raw_arg, std::size_t key_index) {
+            raw_args.push_back(raw_arg);
+            key_indices.push_back(key_index);
+        }
+
+        void freeze() { }   // Keys are not counted; see CLIMapKeyStats.
+
+        std::size_t find(const ArgType& arg, bool = true) const {
+            for (std::size_t i = 0; i != raw_args.size(); ++i) {
+                if (raw_args[i] == arg) return key_indices[i];
+            }
+            return npos;
+        }
+
+        bool contains(const ArgType& arg) const {
+            return find(arg) != npos;
+        }
+
+    private:
+        std::vector<ArgType> raw_args;
+        std::vector<std::size_t> key_indices;
+};
+
+template<>
+class CLIMapRawArgs<const char *> {
+    // Key strings are copied into one contiguous pool, so keys need not outlive the map and copies
+    // of the map stay valid. The first prefix_size bytes of every key are also stored inline (zero
+    // padded), so that most mismatches are rejected by a single integer comparison without touching
+    // the pool. The argument's prefix is loaded once per lookup, not once per key. Under
+    // CLIMapMatchPolicy::case_insensitive keys are folded as they are added, and each argument is
+    // folded once per lookup before the same exact comparison. A CLIMapKeyStats profile or mode may
+    // scan the keys most hit first, which gives the same results, as explained in CLIMapKeyStats.hpp.
+    public:
+        static constexpr std::size_t npos = std::numeric_limits<std::size_t>::max();
+
+        explicit CLIMapRawArgs(CLIMapMatchPolicy policy_in = CLIMapMatchPolicy::exact): policy{policy_in} { }
+
+        void push_back(const char * raw_arg, std::size_t key_index) {
+            std::size_t length = std::strlen(raw_arg);
+            std::vector<char> folded;
+            if (policy == CLIMapMatchPolicy::case_insensitive) {
+                folded.resize(CLIMapCaseFold::capacity(length));
+                length = CLIMapCaseFold::fold(raw_arg, length, folded.data());
+                raw_arg = folded.data();
+            }
+            prefixes.push_back(prefix_of(raw_arg));
+            lengths.push_back(length);
+            offsets.push_back(pool.size());
+            pool.insert(pool.end(), raw_arg, raw_arg + length + 1);
+            key_indices.push_back(key_index);
+        }
+
+        void freeze() {
+            // Called once every key has been added, so that CLIMapKeyStats may reorder and count them.
+            const CLIMapKeyCounts::FreezeHook freeze_hook = CLIMapKeyCounts::freeze_hook();
+            if (freeze_hook != nullptr) counts = freeze_hook(*this);
+        }
+
+        std::size_t find(const char * arg, bool counted = true) const {
+            // Counts a hit, while counting, unless looking ahead of dispatch.
+            return policy == CLIMapMatchPolicy::exact ? find_exact(arg, counted) : find_folded(arg, counted);
+        }
+
+        bool contains(const char * arg) const {
+            // As find() != npos, without counting a hit.
+            const bool counted = false;
+            return find(arg, counted) != npos;
+        }
+
+        std::uint64_t signature() const {
+            // FNV-1a of the policy and the keys, as stored, in the order added.
+            std::uint64_t hash = 14695981039346656037u;
+            auto add_byte = [&hash](unsigned char byte) { hash = (hash ^ byte) * 1099511628211u; };
+            add_byte(static_cast<unsigned char>(policy));
+            for (char c: pool) add_byte(static_cast<unsigned char>(c));
+            return hash;
+        }
+
+    private:
+        friend class CLIMapKeyStats;
+
+        static constexpr std::size_t prefix_size = sizeof(std::uint64_t);
+        static constexpr std::size_t folded_arg_buffer_size = 256;
+
+        bool matches_at(std::size_t position, const char * arg, std::uint64_t arg_prefix) const {
+            // A key shorter than prefix_size has its terminator in the prefix, so equal prefixes mean equal strings.
+            return prefixes[position] == arg_prefix && (lengths[position] < prefix_size || std::strcmp(key(position) + prefix_size, arg + prefix_size) == 0);
+        }
+
+        std::size_t find_exact(const char * arg, bool counted) const {
+            if (counts != nullptr && counted) return counts->find(*this, arg);
+            const std::uint64_t arg_prefix = prefix_of(arg);
+            for (std::size_t i = 0; i != prefixes.size(); ++i) {
+                if (matches_at(i, arg, arg_prefix)) return key_indices[i];
+            }
+            return npos;
+        }
+
+        std::size_t find_folded(const char * arg, bool counted) const {
+            // Folds arg on the stack, unless it is too long to.
+            const std::size_t length = std::strlen(arg);
+            const std::size_t capacity = CLIMapCaseFold::capacity(length);
+            if (capacity <= folded_arg_buffer_size) {
+                char folded[folded_arg_buffer_size];
+                CLIMapCaseFold::fold(arg, length, folded);
+                return find_exact(folded, counted);
+            }
+            std::vector<char> folded(capacity);
+            CLIMapCaseFold::fold(arg, length, folded.data());
+            return find_exact(folded.data(), counted);
+        }
+
+        const char * key(std::size_t position) const {
+            return pool.data() + offsets[position];
+        }
+
+        std::size_t size() const {
+            return key_indices.size();
+        }
+
+        void reorder(const std::vector<std::size_t>& positions) {
+            // Moves the key at positions[i] to position i.
+            permute(prefixes, positions);
+            permute(lengths, positions);
+            permute(offsets, positions);
+            permute(key_indices, positions);
+        }
+
+        template<typename T>
+        static void permute(std::vector<T>& values, const std::vector<std::size_t>& positions) {
+            std::vector<T> permuted;
+            permuted.reserve(values.size());
+            for (std::size_t position: positions) permuted.push_back(values[position]);
+            values.swap(permuted);
+        }
+
+        static std::uint64_t prefix_of(const char * str) noexcept {
+            char bytes[prefix_size] = {};
+            for (std::size_t i = 0; i != prefix_size && str[i] != '\0'; ++i) bytes[i] = str[i];
+            std::uint64_t prefix;
+            std::memcpy(&prefix, bytes, prefix_size);
+            return prefix;
+        }
+
+        CLIMapMatchPolicy policy;
+        std::vector<std::uint64_t> prefixes;
+        std::vector<std::size_t> lengths;
+        std::vector<std::size_t> offsets;   // Into pool.
+        std::vector<std::size_t> key_indices;
+        std::vector<char> pool;
+        CLIMapKeyCounts * counts = nullptr;     // Unless counting.
+};
+
+template <typename ArgType = CLIMapDT::ArgType, typename MatchFnType = CLIMapDT::MatchFnType, typename ArgIterator = CLIMapDT::ArgIterator>
+class CLIMap {
+    // Yet to be automatically unit (and regression?) tested. See test/MapTestManual for a manual testing application.
+    friend class CLIMapKeyTester;
+    template<typename, typename, typename> friend class CLIMapAsync;
+    template<typename> friend struct CLIMapSpeculative;
+    template<typename> friend struct CLIMapPure;
+
+    private:
+        class CLIMapKey;
+        class CLIMapKeyTable;
+
+        class ParallelDispatch;     // See CLIMapParallel.hpp.
+        class CachedCall;           // See CLIMapResultCache.hpp.
+
+        using HandlerType = int (*)(int, ArgIterator);
+        using BulkHandlerType = int (*)(int, ArgIterator, int);
+
+    public:
+        class Handler;
+        using RawPairType = std::pair<CLIMapKey, Handler>;
+
+    private:
+        using RawMapType = std::initializer_list<RawPairType>;
+
+        static constexpr std::size_t npos = CLIMapRawArgs<ArgType>::npos;
+
+        struct DispatchState {  // The position of exec_base's loop, stepped by dispatch_first and dispatch_next.
+            int argc_callee;
+            ArgIterator argv_callee;
+            std::size_t match_index;
+            int argc_left_or_error;
+            int run = 1;                        // Arguments from argv_callee matched to match_index, by bulk_run.
+            bool run_end_matched = false;       // Whether bulk_run also matched the argument after them,
+            std::size_t run_end_index = npos;   // to this key.
+        };
+
+        using ExecHook = int (*)(const CLIMap&, int, ArgIterator, int, bool);                  // As exec_base.
+        using CallHook = int (*)(const CLIMap&, const Handler&, const DispatchState&, bool);   // As call.
+
+        CLIMapKeyTable key_table;
+        std::vector<Handler> handlers;  // Indexed by key declaration order.
+        ExecHook exec_hook = nullptr;   // The first that a handler's marks bring, if any.
+
+        template<typename RawPairIter>
+        CLIMap(RawPairIter first, RawPairIter last, CLIMapMatchPolicy policy): key_table(first, last, policy) {
+            for (; first != last; ++first) {
+                handlers.push_back(first->second);
+                if (exec_hook == nullptr) exec_hook = first->second.exec_hook;
+            }
+        }
+
+        static DispatchState dispatch_first(const CLIMapKeyTable& key_table, int argc_caller, ArgIterator argv_caller, int args_to_skip) {
+            if (argc_caller - args_to_skip <= 0) {
                 throw std::domain_error(
                         "CLIMap::exec called with argc_caller - args_to_skip <=0: "
                         "argc_caller = " + std::to_string(argc_caller) + \
@@ -146,13 +738,189 @@ class CLIMap {
                 );
             }
 
-            return argc_left_or_error;
+            DispatchState state;
+            state.argv_callee = argv_caller;
+            std::advance(state.argv_callee, args_to_skip);  // The argument that triggered the calling function.
+            ArgIterator first_arg = state.argv_callee;
+            if (argc_caller - args_to_skip > 1) std::advance(first_arg, 1);
+            if (argc_caller - args_to_skip == 1 || is_end_of_args(*first_arg)) {
+                state.argc_callee = argc_caller - args_to_skip;     // No arguments for callee, bar maybe noarg.
+                state.match_index = key_table.find(noarg);
+            } else {
+                state.argc_callee = argc_caller - (1+args_to_skip);
+                state.argv_callee = first_arg;
+                state.match_index = key_table.find(*first_arg, true);
+            }
+            state.argc_left_or_error = state.argc_callee;   // In case arg has no matching handler function.
+            return state;
+        }
+
+        template<typename T>
+        static bool is_end_of_args(const T&) {
+            return false;
+        }
+
+        template<typename T>
+        static bool is_end_of_args(T * const & arg) {
+            // A null argument ends unbounded sources (see CLIMAP_UNBOUNDED_ARGC), as argv[argc] is null.
+            return arg == nullptr;
+        }
+
+        static bool dispatch_next(const CLIMapKeyTable& key_table, DispatchState& state, int argc_left_or_error, bool match_on_anyarg_in_loop) {
+            // Takes the return value of the handler just called, and returns false if the loop is to break
+            // because it was unsuccessful or there are no arguments left to parse.
+            state.argc_left_or_error = argc_left_or_error;
+            if (argc_left_or_error <= 0 || argc_left_or_error == ARGMAP_EXIT_INVALID_ARG) return false;
+
+            // Find the next argument to parse (and associated argc), look it up in key_table and break if no match found.
+            auto number_of_args_handled = state.argc_callee - argc_left_or_error; // This is why argc_callee and argc_left_or_error are different variables.
+            std::advance(state.argv_callee, number_of_args_handled);
+            state.argc_callee = argc_left_or_error;
+            if (is_end_of_args(*state.argv_callee)) {   // An unbounded source ran out, so every argument was handled.
+                state.argc_left_or_error = 0;
+                return false;
+            }
+            if (number_of_args_handled < state.run) {   // Within a bulk run, so already matched to its key.
+                state.run -= number_of_args_handled;
+                return true;
+            }
+            if (number_of_args_handled == state.run && state.run_end_matched) {
+                state.match_index = state.run_end_index;
+            } else {
+                state.match_index = key_table.find(*state.argv_callee, match_on_anyarg_in_loop);
+            }
+            state.run = 1;
+            state.run_end_matched = false;
+            return state.match_index != npos;
+        }
+
+        int exec_base(int argc_caller, ArgIterator argv_caller, int args_to_skip, bool match_on_anyarg_in_loop) const {
+             // Will need bulk testing.
+            CLIMapProfiler * const profiler = CLIMapProfiler::active();
+            if (profiler != nullptr) return exec_base_profiled(*profiler, argc_caller, argv_caller, args_to_skip, match_on_anyarg_in_loop);
+            if (exec_hook != nullptr) return exec_hook(*this, argc_caller, argv_caller, args_to_skip, match_on_anyarg_in_loop);
+            return exec_sequential(argc_caller, argv_caller, args_to_skip, match_on_anyarg_in_loop);
+        }
+
+        int exec_sequential(int argc_caller, ArgIterator argv_caller, int args_to_skip, bool match_on_anyarg_in_loop) const {
+            DispatchState state = dispatch_first(key_table, argc_caller, argv_caller, args_to_skip);
+            if (state.match_index != npos) {
+                // Call function matched to the next argument to parse, until dispatch_next finds nothing more to do.
+                while (dispatch_next(key_table, state, call(handlers[state.match_index], state, match_on_anyarg_in_loop), match_on_anyarg_in_loop)) { }
+            }
+            // Loop exits with:
+            //      * state.argc_left_or_error up-to-date, which is then returned.
+            //      * state.match_index indicating no-match, or indexing the last handling function executed.
+            return state.argc_left_or_error;
+        }
+
+        int call(const Handler& handler, DispatchState& state, bool match_on_anyarg_in_loop) const {
+            if (handler.call_hook != nullptr) return handler.call_hook(*this, handler, state, match_on_anyarg_in_loop);
+            if (handler.bulk_function == nullptr) return handler.function(state.argc_callee, state.argv_callee);
+            return handler.bulk_function(state.argc_callee, state.argv_callee, bulk_run(state, match_on_anyarg_in_loop));
+        }
+
+        int bulk_run(DispatchState& state, bool match_on_anyarg_in_loop) const {
+            // The number of arguments from state's that dispatch would match to the same key, one by one.
+            // Matches are kept in state, for the rest of a run the handler leaves and the argument ending it.
+            if (state.run_end_matched) return state.run;
+            ArgIterator arg = state.argv_callee;
+            std::advance(arg, state.run - 1);
+            while (state.run < state.argc_callee && state.run < CLIMAP_BULK_RUN_LIMIT) {
+                ++arg;
+                // find would match arg to a raw arg key declared before the run's, so dispatch matches it when it gets there.
+                if (is_end_of_args(*arg) || key_table.find_raw_arg(*arg) < state.match_index) break;
+                const std::size_t match_index = key_table.find(*arg, match_on_anyarg_in_loop);
+                if (match_index != state.match_index) {
+                    state.run_end_matched = true;
+                    state.run_end_index = match_index;
+                    break;
+                }
+                ++state.run;
+            }
+            return state.run;
+        }
+
+        int exec_base_profiled(CLIMapProfiler& profiler, int argc_caller, ArgIterator argv_caller, int args_to_skip, bool match_on_anyarg_in_loop) const {
+            // exec_base, with each matching step and handler call reported to profiler.
+            DispatchState state;
+            {
+                CLIMapProfiler::Phase matching(profiler);
+                state = dispatch_first(key_table, argc_caller, argv_caller, args_to_skip);
+            }
+
+            bool more_to_do = state.match_index != npos;
+            while (more_to_do) {
+                const Handler& handler = handlers[state.match_index];
+                int argc_left_or_error;
+                {
+                    CLIMapProfiler::Phase handling(profiler, handler.bulk_function != nullptr
+                            ? reinterpret_cast<CLIMapProfiler::HandlerId>(handler.bulk_function)
+                            : reinterpret_cast<CLIMapProfiler::HandlerId>(handler.function));
+                    argc_left_or_error = call(handler, state, match_on_anyarg_in_loop);
+                }
 
+                CLIMapProfiler::Phase matching(profiler);
+                more_to_do = dispatch_next(key_table, state, argc_left_or_error, match_on_anyarg_in_loop);
+            }
+            return state.argc_left_or_error;
+        }
+
+        static const char * arg_cstring(const char * const & arg) {
+            return arg;
+        }
+
+        template<typename T>
+        static const char * arg_cstring(const T&) {
+            return nullptr;
+        }
+
+        static void write_outcome(int argc_caller, ArgIterator argv_caller, int argc_left_or_error) {
+            // In a format other than text, so once a CLIMapOutputWriter is installed.
+            CLIMapOutputWriter * const writer = CLIMapOutputWriter::active();
+            if (argc_left_or_error == ARGMAP_EXIT_INVALID_ARG) {
+                writer->write_invalid_argument();
+            } else if (argc_left_or_error > 0) {
+                int unrecognised_arg_index = argc_caller - argc_left_or_error;
+                ArgIterator unrecognised_arg_iter = argv_caller;
+                std::advance(unrecognised_arg_iter, unrecognised_arg_index);
+                const ArgType& unrecognised_arg = *unrecognised_arg_iter;
+                writer->write_unrecognised_argument(unrecognised_arg_index, arg_cstring(unrecognised_arg));
+            }
+            climap_cout().flush();
+        }
+
+        int exec_main_base(int argc_caller, ArgIterator argv_caller, int args_to_skip) const {
+            bool match_on_anyarg_in_loop = true;
+            CLIMapRecorder::record_if_active(argc_caller, argv_caller, args_to_skip);
+            if (argc_caller - args_to_skip > 1) {
+                ArgIterator first_arg = argv_caller;
+                std::advance(first_arg, 1+args_to_skip);
+                const ArgType& arg = *first_arg;
+                if (!is_end_of_args(arg) && CLIMapProfiler::activate_on_switch(arg)) ++args_to_skip;
+            }
+            return exec_base(argc_caller, argv_caller, args_to_skip, match_on_anyarg_in_loop);
         }
 
 
     public:
-        constexpr CLIMap(std::initializer_list<CLIMap<ArgType, MatchFnType, ArgIterator>::RawPairType> init_list): raw_map(init_list) { }
+        class Builder;
+        class Incremental;     // See CLIMapIncremental.hpp.
+
+        // Keys and handlers are copied out of init_list, which need not outlive the map. Declare maps
+        // local to a handler static const, so that the key table is built once rather than per call.
+        CLIMap(std::initializer_list<CLIMap<ArgType, MatchFnType, ArgIterator>::RawPairType> init_list): CLIMap(init_list.begin(), init_list.end(), CLIMapMatchPolicy::exact) { }
+
+        // e.g. static const CLIMap<> climap(CLIMapMatchPolicy::case_insensitive, { {"fib", fib_main}, ... });
+        CLIMap(CLIMapMatchPolicy policy, std::initializer_list<CLIMap<ArgType, MatchFnType, ArgIterator>::RawPairType> init_list): CLIMap(init_list.begin(), init_list.end(), policy) { }
+
+        // For large maps. An initializer list's pairs are constructed by code the compiler must
+        // generate and optimise, whereas a static constexpr array of them is constant initialised:
+        //      static constexpr CLIMap<>::RawPairType climap_keys[] { {"fib", fib_main}, ... };
+        //      static const CLIMap<> climap(climap_keys);
+        // See bench/compile_cost.cpp for the difference in compile time.
+        template<std::size_t N>
+        explicit CLIMap(const RawPairType (&raw_pairs)[N], CLIMapMatchPolicy policy = CLIMapMatchPolicy::exact): CLIMap(raw_pairs, raw_pairs + N, policy) { }
 
         int exec(int argc_caller, ArgIterator argv_caller, int args_to_skip = 0) const {
             bool match_on_anyarg_in_loop = false;
@@ -161,20 +929,35 @@ class CLIMap {
 
         int exec_main(int argc_caller, ArgIterator argv_caller) const {
             int args_to_skip = 0;
-            bool match_on_anyarg_in_loop = true;
-            return exec_base(argc_caller, argv_caller, args_to_skip, match_on_anyarg_in_loop);
+            return exec_main_base(argc_caller, argv_caller, args_to_skip);
         }
 
         int exec_main(int argc_caller, ArgIterator argv_caller, int args_to_skip) const {
-            bool match_on_anyarg_in_loop = true;
-            return exec_base(argc_caller, argv_caller, args_to_skip, match_on_anyarg_in_loop);
+            return exec_main_base(argc_caller, argv_caller, args_to_skip);
+        }
+
+        // Also writes the outcome, if an error, as a CLIMapOutput record; handlers' results and errors
+        // are written in format too. e.g. exec_main(argc, argv, CLIMapOutputFormat::ndjson)
+        int exec_main(int argc_caller, ArgIterator argv_caller, CLIMapOutputFormat format, int args_to_skip = 0) const {
+            CLIMapOutputWriter::Scope format_scope(format);
+            int argc_left_or_error = exec_main_base(argc_caller, argv_caller, args_to_skip);
+            if (format != CLIMapOutputFormat::text) write_outcome(argc_caller, argv_caller, argc_left_or_error);
+            return argc_left_or_error;
         }
 
         template<typename MsgType>
         int exec_main(int argc_caller, ArgIterator argv_caller, const MsgType& invalid_arg_message, int args_to_skip = 0) const {
-            bool match_on_anyarg_in_loop = true;
-            int argc_left_or_error = exec_base(argc_caller, argv_caller, args_to_skip, match_on_anyarg_in_loop);
-            if (argc_left_or_error == ARGMAP_EXIT_INVALID_ARG) {
+            return exec_main(argc_caller, argv_caller, invalid_arg_message, CLIMapOutputWriter::format(), args_to_skip);
+        }
+
+        // As above, but printing invalid_arg_message in text.
+        template<typename MsgType>
+        int exec_main(int argc_caller, ArgIterator argv_caller, const MsgType& invalid_arg_message, CLIMapOutputFormat format, int args_to_skip = 0) const {
+            CLIMapOutputWriter::Scope format_scope(format);
+            int argc_left_or_error = exec_main_base(argc_caller, argv_caller, args_to_skip);
+            if (format != CLIMapOutputFormat::text) {
+                write_outcome(argc_caller, argv_caller, argc_left_or_error);
+            } else if (argc_left_or_error == ARGMAP_EXIT_INVALID_ARG) {
                 std::cout << invalid_arg_message;
             } else if (argc_left_or_error > 0) {
                 int unrecognised_arg_index = argc_caller - argc_left_or_error;
@@ -226,6 +1009,8 @@ class CLIMap<ArgType, MatchFnType, ArgIterator>::CLIMapKey {
         }
 
     private:
+        friend class CLIMap<ArgType, MatchFnType, ArgIterator>::CLIMapKeyTable;
+
         union RawKey {
             ArgType raw_arg;
             MatchFnType matching_function;
@@ -259,4 +1044,139 @@ class CLIMap<ArgType, MatchFnType, ArgIterator>::CLIMapKey {
         }
 };
 
+
+template<typename ArgType, typename MatchFnType, typename ArgIterator>
+class CLIMap<ArgType, MatchFnType, ArgIterator>::Handler {
+    // A key's handler function, and the hooks its marks bring (see CLIMapUnmarked), or whether it
+    // takes runs of arguments (see climap_bulk).
+    public:
+        constexpr Handler(HandlerType function_in): function{function_in}, bulk_function{nullptr}, exec_hook{nullptr}, call_hook{nullptr} { }
+
+        template<typename Marks>
+        constexpr Handler(CLIMapMarkedHandler<ArgIterator, Marks> marked_in): function{marked_in.function}, bulk_function{nullptr},
+                exec_hook{Marks::template exec_hook<CLIMap>()}, call_hook{Marks::template call_hook<CLIMap>()} { }
+
+        constexpr Handler(CLIMapBulkHandler<ArgIterator> bulk_in): function{nullptr}, bulk_function{bulk_in.function}, exec_hook{nullptr}, call_hook{nullptr} { }
+
+    private:
+        friend class CLIMap<ArgType, MatchFnType, ArgIterator>;
+
+        HandlerType function;           // Unless bulk_function.
+        BulkHandlerType bulk_function;
+        ExecHook exec_hook;
+        CallHook call_hook;
+};
+
+
+template<typename ArgType, typename MatchFnType, typename ArgIterator>
+class CLIMap<ArgType, MatchFnType, ArgIterator>::Builder {
+    // Assembles a CLIMap at run time, e.g. from configuration or plugins. freeze() snapshots the keys
+    // and handlers added so far into an immutable CLIMap, which has no mutable state and so may be
+    // shared read-only across threads. Keys take priority in the order they are added, as they
+    // would in an initializer list.
+    public:
+        Builder() = default;
+        Builder(const Builder&) = delete;
+        Builder& operator=(const Builder&) = delete;
+        Builder(Builder&&) = default;
+        Builder& operator=(Builder&&) = default;
+
+        Builder& add(const CLIMapKey& key, const Handler& handler) {
+            raw_pairs.emplace_back(key, handler);
+            return *this;
+        }
+
+        Builder& add(const ArgType& raw_arg, const Handler& handler) {
+            return add(CLIMapKey(raw_arg), handler);
+        }
+
+        Builder& add(const std::string& raw_arg, const Handler& handler) {   // Copies raw_arg, for keys that do not outlive the builder's caller.
+            owned_raw_args.push_back(raw_arg);
+            return add(CLIMapKey(owned_raw_args.back().c_str()), handler);
+        }
+
+        Builder& match_policy(CLIMapMatchPolicy policy_in) {
+            policy = policy_in;
+            return *this;
+        }
+
+        std::size_t size() const {
+            return raw_pairs.size();
+        }
+
+        CLIMap freeze() const {
+            return CLIMap(raw_pairs.begin(), raw_pairs.end(), policy);
+        }
+
+    private:
+        CLIMapMatchPolicy policy = CLIMapMatchPolicy::exact;
+        std::vector<RawPairType> raw_pairs;
+        std::deque<std::string> owned_raw_args; // std::deque never relocates elements, so raw_pairs may point into it.
+};
+
+template<typename ArgType, typename MatchFnType, typename ArgIterator>
+class CLIMap<ArgType, MatchFnType, ArgIterator>::CLIMapKeyTable {
+    // Frozen struct-of-arrays layout of a CLIMap's keys, grouped by key type. Lookups return the
+    // declaration index of the first matching key, as a find_if over the declared keys would, but
+    // scan the cheap raw arg keys first and call matching functions only while they could still win.
+    public:
+        template<typename RawPairIter>
+        CLIMapKeyTable(RawPairIter first, RawPairIter last, CLIMapMatchPolicy policy = CLIMapMatchPolicy::exact): raw_args(policy), any_arg_index{npos}, no_arg_index{npos} {
+            for (std::size_t key_index = 0; first != last; ++first, ++key_index) {
+                const CLIMapKey& key = first->first;
+                if (key.key_type == CLIMapKey::RawKeyType::raw_arg) {
+                    raw_args.push_back(key.key.raw_arg, key_index);
+                } else if (key.key_type == CLIMapKey::RawKeyType::matching_function) {
+                    matching_functions.push_back(key.key.matching_function);
+                    matching_function_indices.push_back(key_index);
+                } else if (key.key_type == CLIMapKey::RawKeyType::any_arg) {
+                    if (any_arg_index == npos) any_arg_index = key_index;
+                } else if (key.key_type == CLIMapKey::RawKeyType::no_arg) {
+                    if (no_arg_index == npos) no_arg_index = key_index;
+                }
+            }
+            raw_args.freeze();
+        }
+
+        std::size_t find(const ArgType& arg, bool match_on_anyarg) const {
+            std::size_t match_index = raw_args.find(arg);
+            if (match_on_anyarg && any_arg_index < match_index) match_index = any_arg_index;
+            // Matching functions may have side effects, so only those declared before the best match so far are called.
+            for (std::size_t i = 0; i != matching_functions.size() && matching_function_indices[i] < match_index; ++i) {
+                if (matching_functions[i](arg)) {
+                    match_index = matching_function_indices[i];
+                    break;
+                }
+            }
+            return match_index;
+        }
+
+        std::size_t find(NoArgType) const {
+            return no_arg_index;
+        }
+
+        bool matches_raw_arg(const ArgType& arg) const {
+            return raw_args.contains(arg);
+        }
+
+        std::size_t find_raw_arg(const ArgType& arg) const {
+            // The raw arg key arg matches, if any, without counting a hit or calling matching functions,
+            // which may have side effects, for looking ahead of dispatch. find may still match arg to
+            // a key declared before it.
+            const bool counted = false;
+            return raw_args.find(arg, counted);
+        }
+
+        std::uint64_t signature() const {    // C string args only.
+            return raw_args.signature();
+        }
+
+    private:
+        CLIMapRawArgs<ArgType> raw_args;
+        std::vector<typename std::remove_const<MatchFnType>::type> matching_functions;
+        std::vector<std::size_t> matching_function_indices;
+        std::size_t any_arg_index;
+        std::size_t no_arg_index;
+};
+
 #endif
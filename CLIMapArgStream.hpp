@@ -0,0 +1,182 @@
+#ifndef CLIMAP_ARG_STREAM_HEADER_GUARD
+#define CLIMAP_ARG_STREAM_HEADER_GUARD
+
+// Optional lazily read arguments for CLIMap. A CLIMapArgStream tokenises a file descriptor, such as
+// a pipe, into arguments as dispatch reaches them, so that a map can be run over more arguments than
+// would fit in memory, and start before the input ends:
+//
+//      using StreamMap = CLIMap<const char*, CLIMapDT::MatchFnType, CLIMapArgStream::iterator>;
+//      int add_main(int argc, CLIMapArgStream::iterator argv);
+//      ...
+//      static const StreamMap climap {
+//          {"add", add_main},
+//          ...
+//      };
+//      CLIMapArgStream args(STDIN_FILENO, "prog");
+//      return climap.exec_main(CLIMAP_UNBOUNDED_ARGC, args.begin());
+//
+// Arguments are separated by one separator character, '\n' by default, or '\0' for the output of
+// find -print0 and the like. Consecutive separators give empty arguments, and a final separator is
+// optional. Index 0 is the given program name, as in argv.
+//
+// As the number of arguments is unknown, argc is CLIMAP_UNBOUNDED_ARGC and counts down from there.
+// The argument after the last is null, as argv[argc] is, which ends dispatch, and which handlers
+// taking arguments check for instead of argc. Only the latest window arguments read are kept, so
+// memory stays constant; reading an earlier one throws std::out_of_range. Bulk handlers (see
+// climap_bulk) need a window longer than CLIMAP_BULK_RUN_LIMIT. Failing to read the file
+// descriptor throws std::runtime_error. Iterators share their stream, and are not thread safe.
+
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <deque>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include "CLIMap.hpp"
+
+class CLIMapArgStream {
+    public:
+        class iterator;
+
+        explicit CLIMapArgStream(int fd_in, const char * name = "", char separator_in = '\n', std::size_t window_in = 4096)
+                : fd{fd_in}, separator{separator_in}, window{window_in == 0 ? 1 : window_in}, buffer(64*1024) {
+            tokens.emplace_back(name);
+        }
+
+        CLIMapArgStream(const CLIMapArgStream&) = delete;
+        CLIMapArgStream& operator=(const CLIMapArgStream&) = delete;
+
+        iterator begin();
+
+        // The argument at index, reading up to it if needed, or nullptr past the last.
+        const char * at(std::size_t index) {
+            if (index < first_index) {
+                throw std::out_of_range("CLIMapArgStream: argument " + std::to_string(index) + " is no longer buffered.");
+            }
+            while (index - first_index >= tokens.size()) {
+                if (!read_token()) return nullptr;
+            }
+            return tokens[index - first_index].c_str();
+        }
+
+        std::size_t buffered() const {
+            return tokens.size();
+        }
+
+    private:
+        int fd;
+        char separator;
+        std::size_t window;
+        std::deque<std::string> tokens;     // Arguments first_index onwards.
+        std::size_t first_index = 0;
+        std::vector<char> buffer;
+        std::size_t buffer_begin = 0;
+        std::size_t buffer_end = 0;
+        bool at_eof = false;
+
+        bool read_token() {
+            std::string token;
+            while (true) {
+                const char * begin = buffer.data() + buffer_begin;
+                const char * end = buffer.data() + buffer_end;
+                const char * found = static_cast<const char *>(std::memchr(begin, separator, end - begin));
+                if (found != nullptr) {
+                    token.append(begin, found);
+                    buffer_begin += found - begin + 1;
+                    break;
+                }
+                token.append(begin, end);
+                buffer_begin = buffer_end = 0;
+                if (at_eof || !fill()) {
+                    if (token.empty()) return false;    // No argument after a final separator.
+                    break;
+                }
+            }
+            tokens.push_back(std::move(token));
+            if (tokens.size() > window) {
+                tokens.pop_front();
+                ++first_index;
+            }
+            return true;
+        }
+
+        bool fill() {
+            while (true) {
+                const ssize_t count = ::read(fd, buffer.data(), buffer.size());
+                if (count > 0) {
+                    buffer_end = static_cast<std::size_t>(count);
+                    return true;
+                }
+                if (count == 0) {
+                    at_eof = true;
+                    return false;
+                }
+                if (errno != EINTR) throw std::runtime_error(std::string("CLIMapArgStream: ") + std::strerror(errno) + ".");
+            }
+        }
+};
+
+// A position in a CLIMapArgStream. Copies read the same stream, so advancing one never moves another,
+// and handlers may index ahead with argv[n] as they would in argv.
+class CLIMapArgStream::iterator {
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = const char *;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const char * const *;
+        using reference = const char *;
+
+        iterator() = default;
+        iterator(CLIMapArgStream * stream_in, std::size_t index_in): stream{stream_in}, index{index_in} { }
+
+        reference operator*() const {
+            return stream->at(index);
+        }
+
+        reference operator[](difference_type offset) const {
+            return stream->at(index + offset);
+        }
+
+        iterator& operator++() {
+            ++index;
+            return *this;
+        }
+
+        iterator operator++(int) {
+            iterator previous = *this;
+            ++index;
+            return previous;
+        }
+
+        iterator& operator+=(difference_type offset) {
+            index += offset;
+            return *this;
+        }
+
+        friend iterator operator+(iterator it, difference_type offset) {
+            return it += offset;
+        }
+
+        friend bool operator==(const iterator& lhs, const iterator& rhs) {
+            return lhs.stream == rhs.stream && lhs.index == rhs.index;
+        }
+
+        friend bool operator!=(const iterator& lhs, const iterator& rhs) {
+            return !(lhs == rhs);
+        }
+
+    private:
+        CLIMapArgStream * stream = nullptr;
+        std::size_t index = 0;
+};
+
+inline CLIMapArgStream::iterator CLIMapArgStream::begin() {
+    return iterator(this, first_index);
+}
+
+#endif
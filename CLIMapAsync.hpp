@@ -0,0 +1,297 @@
+#ifndef CLIMAP_ASYNC_HEADER_GUARD
+#define CLIMAP_ASYNC_HEADER_GUARD
+
+// Optional coroutine handlers for CLIMap, requiring c++20. A CLIMapAsync maps keys to either the
+// usual synchronous handlers or to coroutine handlers returning CLIMapTask<int>, with the same
+// return value conventions. Coroutine handlers co_await climap_checkpoint() wherever they may be
+// interleaved with other commands, timed out, or cancelled. A CLIMapScheduler runs many in-flight
+// commands on a single thread, resuming them round robin from checkpoint to checkpoint.
+//
+// Cancellation is cooperative: a cancelled (or late) command is unwound by throwing
+// CLIMapCancelled from its next checkpoint, so handlers release resources as they would for any
+// other exception. The synchronous CLIMap API is untouched by this header.
+
+#include "CLIMap.hpp"
+
+#if __cplusplus >= 202002L && defined(__cpp_impl_coroutine)
+
+#include <chrono>
+#include <coroutine>
+#include <deque>
+#include <exception>
+#include <memory>
+
+template<typename T = int>
+class CLIMapTask {
+    // Lazily started coroutine result. Awaiting a task starts it, and resumes the awaiter when it finishes.
+    public:
+        class promise_type {
+            friend class CLIMapTask;
+            friend class CLIMapScheduler;
+
+            public:
+                CLIMapTask get_return_object() {
+                    return CLIMapTask(std::coroutine_handle<promise_type>::from_promise(*this));
+                }
+
+                std::suspend_always initial_suspend() noexcept { return {}; }
+
+                auto final_suspend() noexcept {
+                    struct FinalAwaiter {
+                        bool await_ready() noexcept { return false; }
+                        std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> handle) noexcept {
+                            auto continuation = handle.promise().continuation;
+                            return continuation ? continuation : std::noop_coroutine();
+                        }
+                        void await_resume() noexcept { }
+                    };
+                    return FinalAwaiter{};
+                }
+
+                void return_value(T value_in) { value = std::move(value_in); }
+
+                void unhandled_exception() { exception = std::current_exception(); }
+
+            private:
+                T value{};
+                std::exception_ptr exception;
+                std::coroutine_handle<> continuation;
+        };
+
+        CLIMapTask(CLIMapTask&& other) noexcept: handle{std::exchange(other.handle, nullptr)} { }
+        CLIMapTask& operator=(CLIMapTask&& other) noexcept {
+            if (this != &other) {
+                if (handle) handle.destroy();
+                handle = std::exchange(other.handle, nullptr);
+            }
+            return *this;
+        }
+        ~CLIMapTask() {
+            if (handle) handle.destroy();
+        }
+
+        bool await_ready() const noexcept { return !handle || handle.done(); }
+
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+            handle.promise().continuation = awaiting;
+            return handle;
+        }
+
+        T await_resume() {
+            if (handle.promise().exception) std::rethrow_exception(handle.promise().exception);
+            return std::move(handle.promise().value);
+        }
+
+    private:
+        friend class CLIMapScheduler;
+
+        explicit CLIMapTask(std::coroutine_handle<promise_type> handle_in): handle{handle_in} { }
+
+        std::coroutine_handle<promise_type> handle;
+};
+
+enum class CLIMapJobStatus {running, done, cancelled, deadline_exceeded};
+
+class CLIMapCancelled : public std::exception {
+    public:
+        explicit CLIMapCancelled(CLIMapJobStatus status_in): status{status_in} { }
+
+        const char * what() const noexcept override {
+            return status == CLIMapJobStatus::deadline_exceeded ? "CLIMap command deadline exceeded." : "CLIMap command cancelled.";
+        }
+
+        CLIMapJobStatus status;
+};
+
+class CLIMapScheduler {
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        class Job {
+            // One in-flight command, as returned by spawn. result() is valid once status() is done.
+            friend class CLIMapScheduler;
+            friend class CLIMapCheckpoint;
+
+            public:
+                CLIMapJobStatus status() const { return job_status; }
+
+                int result() const {
+                    if (exception) std::rethrow_exception(exception);
+                    return job_result;
+                }
+
+                void cancel() {
+                    cancel_requested = true;
+                }
+
+            private:
+                Job(CLIMapTask<int>&& task_in, Clock::time_point deadline_in): task{std::move(task_in)}, deadline{deadline_in} { }
+
+                CLIMapJobStatus stop_status() const {   // running if the command may carry on.
+                    if (cancel_requested) return CLIMapJobStatus::cancelled;
+                    if (deadline != Clock::time_point::max() && Clock::now() >= deadline) return CLIMapJobStatus::deadline_exceeded;
+                    return CLIMapJobStatus::running;
+                }
+
+                CLIMapTask<int> task;
+                Clock::time_point deadline;
+                CLIMapJobStatus job_status = CLIMapJobStatus::running;
+                bool cancel_requested = false;
+                int job_result = ARGMAP_EXIT_INVALID_ARG;
+                std::exception_ptr exception;
+        };
+
+        std::shared_ptr<Job> spawn(CLIMapTask<int> task, Clock::duration timeout = Clock::duration::max()) {
+            auto now = Clock::now();
+            auto deadline = timeout >= Clock::time_point::max() - now ? Clock::time_point::max() : now + timeout;
+            std::shared_ptr<Job> job(new Job(std::move(task), deadline));
+            ready.push_back({job, job->task.handle});
+            return job;
+        }
+
+        bool run_one() {
+            // Resumes the longest waiting command until its next checkpoint or completion.
+            // Returns false if no command is waiting.
+            if (ready.empty()) return false;
+            Resumption resumption = std::move(ready.front());
+            ready.pop_front();
+
+            Job& job = *resumption.job;
+            auto& root = job.task.handle;
+            CLIMapJobStatus stop_status = job.stop_status();
+            if (stop_status != CLIMapJobStatus::running && resumption.handle.address() == root.address()) {
+                job.job_status = stop_status;   // Never started, so there is nothing to unwind.
+            } else {
+                CLIMapScheduler* const outer_scheduler = current_scheduler;
+                Resumption* const outer_running = running;
+                current_scheduler = this;
+                running = &resumption;
+                resumption.handle.resume();     // Exceptions are caught by the promise, so this does not throw.
+                current_scheduler = outer_scheduler;
+                running = outer_running;
+                if (!root.done()) return true;
+
+                job.exception = root.promise().exception;
+                job.job_status = CLIMapJobStatus::done;
+                if (job.exception) {
+                    try {
+                        std::rethrow_exception(job.exception);
+                    } catch (const CLIMapCancelled& cancelled) {
+                        job.job_status = cancelled.status;
+                        job.exception = nullptr;
+                    } catch (...) { }
+                } else {
+                    job.job_result = root.promise().value;
+                }
+            }
+            root.destroy();     // Release the frames now rather than when the last Job reference goes.
+            root = nullptr;
+            return true;
+        }
+
+        void run() {
+            while (run_one()) { }
+        }
+
+        std::size_t size() const {  // Number of commands waiting to resume.
+            return ready.size();
+        }
+
+    private:
+        friend class CLIMapCheckpoint;
+
+        struct Resumption {
+            std::shared_ptr<Job> job;
+            std::coroutine_handle<> handle;
+        };
+
+        std::deque<Resumption> ready;
+        Resumption* running = nullptr;
+        inline static thread_local CLIMapScheduler* current_scheduler = nullptr;
+};
+
+class CLIMapCheckpoint {
+    // Awaitable returned by climap_checkpoint(). A checkpoint only suspends if other commands are
+    // waiting, and otherwise costs a couple of branches (and a clock read under a deadline).
+    public:
+        bool await_ready() const noexcept {
+            CLIMapScheduler* scheduler = CLIMapScheduler::current_scheduler;
+            return scheduler == nullptr || scheduler->ready.empty();
+        }
+
+        void await_suspend(std::coroutine_handle<> handle) const {
+            CLIMapScheduler* scheduler = CLIMapScheduler::current_scheduler;
+            scheduler->ready.push_back({scheduler->running->job, handle});
+        }
+
+        void await_resume() const {
+            CLIMapScheduler* scheduler = CLIMapScheduler::current_scheduler;
+            if (scheduler == nullptr) return;
+            CLIMapJobStatus stop_status = scheduler->running->job->stop_status();
+            if (stop_status != CLIMapJobStatus::running) throw CLIMapCancelled(stop_status);
+        }
+};
+
+inline CLIMapCheckpoint climap_checkpoint() {
+    return {};
+}
+
+template <typename ArgType = CLIMapDT::ArgType, typename MatchFnType = CLIMapDT::MatchFnType, typename ArgIterator = CLIMapDT::ArgIterator>
+class CLIMapAsync {
+    // A CLIMap whose handlers may be coroutines. Keys match exactly as they would in a CLIMap.
+    private:
+        using Map = CLIMap<ArgType, MatchFnType, ArgIterator>;
+        using CLIMapKey = typename Map::CLIMapKey;
+        using CLIMapKeyTable = typename Map::CLIMapKeyTable;
+        using DispatchState = typename Map::DispatchState;
+
+    public:
+        class Handler {
+            public:
+                Handler(int (*sync_in)(int, ArgIterator)): sync{sync_in}, async{nullptr} { }
+                Handler(CLIMapTask<int> (*async_in)(int, ArgIterator)): sync{nullptr}, async{async_in} { }
+
+            private:
+                friend class CLIMapAsync;
+                int (*sync)(int, ArgIterator);
+                CLIMapTask<int> (*async)(int, ArgIterator);
+        };
+
+        using RawPairType = std::pair<CLIMapKey, Handler>;
+
+        CLIMapAsync(std::initializer_list<RawPairType> init_list): key_table(init_list.begin(), init_list.end()) {
+            for (const auto& raw_pair: init_list) handlers.push_back(raw_pair.second);
+        }
+
+        CLIMapTask<int> async_exec(int argc_caller, ArgIterator argv_caller, int args_to_skip = 0) const {
+            return async_exec_base(argc_caller, argv_caller, args_to_skip, false);
+        }
+
+        CLIMapTask<int> async_exec_main(int argc_caller, ArgIterator argv_caller, int args_to_skip = 0) const {
+            return async_exec_base(argc_caller, argv_caller, args_to_skip, true);
+        }
+
+    private:
+        CLIMapKeyTable key_table;
+        std::vector<Handler> handlers;
+
+        CLIMapTask<int> async_exec_base(int argc_caller, ArgIterator argv_caller, int args_to_skip, bool match_on_anyarg_in_loop) const {
+            DispatchState state = Map::dispatch_first(key_table, argc_caller, argv_caller, args_to_skip);
+            if (state.match_index != Map::npos) {
+                int argc_left_or_error;
+                do {
+                    const Handler& handler = handlers[state.match_index];
+                    if (handler.async) {
+                        argc_left_or_error = co_await handler.async(state.argc_callee, state.argv_callee);
+                    } else {
+                        argc_left_or_error = handler.sync(state.argc_callee, state.argv_callee);
+                    }
+                } while (Map::dispatch_next(key_table, state, argc_left_or_error, match_on_anyarg_in_loop));
+            }
+            co_return state.argc_left_or_error;
+        }
+};
+
+#endif
+
+#endif
@@ -0,0 +1,139 @@
+#ifndef CLIMAP_INCREMENTAL_HEADER_GUARD
+#define CLIMAP_INCREMENTAL_HEADER_GUARD
+
+// Optional incremental execution for CLIMap, of command lines edited between runs; see
+// CLIMap::Incremental.
+
+#include <cstddef>
+#include <iterator>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "CLIMap.hpp"
+
+template<typename ArgType, typename MatchFnType, typename ArgIterator>
+class CLIMap<ArgType, MatchFnType, ArgIterator>::Incremental {
+    // Runs a map over a command line as it is edited, e.g. to validate it on every keystroke, and
+    // dispatches again only from the first argument that changed since the last run:
+    //      static CLIMap<>::Incremental incremental(climap);
+    //      int argc_left_or_error = incremental.exec_main(argc, argv);
+    // Each run keeps the map's dispatch state after every handler call as a Step. A step is kept while
+    // the arguments its handler took, and the one after, are unchanged, and dispatch carries on after
+    // the last step kept. Steps are kept for this map's own handlers only: a handler that executes a
+    // nested map is one step, called again, nested map and all, whenever one of its arguments changes.
+    // Editing the last query of "fib 1 2 ... 40" therefore calls fib_main, and every query, again, so
+    // only command lines of many top level commands gain much. Kept steps' handlers are not called
+    // again, so they must not leave state that later handlers depend on. An unchanged command line
+    // returns the last result without calling anything. argc must count the arguments, so is never
+    // CLIMAP_UNBOUNDED_ARGC. Runs are sequential, and neither recorded nor profiled: the profile
+    // switch is dispatched as any other argument. The map must outlive the Incremental, which is not
+    // thread safe.
+    public:
+        struct Step {
+            int arg_index;              // The argument the handler was called on, as an index into argv.
+            std::size_t key_index;      // The key it matched, in declaration order.
+            int argc_left_or_error;     // What it returned, counted against the last command line.
+        };
+
+        explicit Incremental(const CLIMap& climap_in): climap(climap_in) { }
+
+        // As CLIMap::exec_main, without the messages.
+        int exec_main(int argc_caller, ArgIterator argv_caller, int args_to_skip = 0) {
+            const int argc_before = static_cast<int>(args.size());
+            const int first_changed = update_args(argc_caller, argv_caller);
+            if (args_to_skip != last_args_to_skip || CLIMapOutputWriter::format() != last_format) {
+                steps_taken.clear();    // Kept steps' output was written in another format.
+            } else if (first_changed == argc_caller && argc_before == argc_caller) {
+                return last_argc_left_or_error;
+            }
+
+            std::size_t kept = 0;
+            while (kept != steps_taken.size() && is_kept(steps_taken[kept], argc_before, first_changed)) ++kept;
+            steps_taken.erase(steps_taken.begin() + kept, steps_taken.end());
+            for (Step& step: steps_taken) step.argc_left_or_error += argc_caller - argc_before;
+
+            last_args_to_skip = -1;     // Until this run finishes, in case a handler throws.
+            DispatchState state = resume(argc_caller, argv_caller, args_to_skip);
+            bool more_to_do = state.match_index != npos;
+            try {
+                while (more_to_do) {
+                    const int arg_index = argc_caller - state.argc_callee;
+                    const std::size_t key_index = state.match_index;
+                    const int argc_left_or_error = climap.call(climap.handlers[key_index], state, true);
+                    steps_taken.push_back(Step{arg_index, key_index, argc_left_or_error});
+                    more_to_do = dispatch_next(climap.key_table, state, argc_left_or_error, true);
+                }
+            } catch (...) {
+                steps_taken.clear();
+                throw;
+            }
+            last_args_to_skip = args_to_skip;
+            last_format = CLIMapOutputWriter::format();
+            last_argc_left_or_error = state.argc_left_or_error;
+            return last_argc_left_or_error;
+        }
+
+        // As CLIMap::exec_main with a format: handlers write in format, and every run writes its outcome,
+        // if an error, as a CLIMapOutput record.
+        int exec_main(int argc_caller, ArgIterator argv_caller, CLIMapOutputFormat format, int args_to_skip = 0) {
+            CLIMapOutputWriter::Scope format_scope(format);
+            const int argc_left_or_error = exec_main(argc_caller, argv_caller, args_to_skip);
+            if (format != CLIMapOutputFormat::text) write_outcome(argc_caller, argv_caller, argc_left_or_error);
+            return argc_left_or_error;
+        }
+
+        // The last run's steps, in order.
+        const std::vector<Step>& steps() const {
+            return steps_taken;
+        }
+
+    private:
+        // Arguments are compared by value, and C strings by their characters.
+        using StoredArgType = typename std::conditional<std::is_same<ArgType, const char *>::value, std::string, ArgType>::type;
+
+        const CLIMap& climap;
+        std::vector<StoredArgType> args;    // The last command line.
+        std::vector<Step> steps_taken;
+        int last_args_to_skip = -1;         // -1 until a run finishes.
+        CLIMapOutputFormat last_format = CLIMapOutputFormat::text;
+        int last_argc_left_or_error = 0;
+
+        int update_args(int argc_caller, ArgIterator argv_caller) {
+            // Copies the command line over the last, returning the index of the first argument that differs.
+            int first_changed = argc_caller;
+            ArgIterator arg = argv_caller;
+            for (int i = 0; i != argc_caller; ++i, ++arg) {
+                if (static_cast<std::size_t>(i) == args.size()) {
+                    args.push_back(*arg);
+                    if (first_changed == argc_caller) first_changed = i;
+                } else if (first_changed != argc_caller || !(args[i] == *arg)) {
+                    args[i] = *arg;
+                    if (first_changed == argc_caller) first_changed = i;
+                }
+            }
+            args.erase(args.begin() + argc_caller, args.end());
+            return first_changed;
+        }
+
+        static bool is_kept(const Step& step, int argc_before, int first_changed) {
+            // Only successful steps are kept, so a failed one is called again, as its arguments may have been fixed.
+            const int argc_left = step.argc_left_or_error;
+            return argc_left > 0 && argc_left != ARGMAP_EXIT_INVALID_ARG && argc_before - argc_left < first_changed;
+        }
+
+        DispatchState resume(int argc_caller, ArgIterator argv_caller, int args_to_skip) const {
+            // The dispatch state after the last step kept, or before the first if none are.
+            if (steps_taken.empty()) return dispatch_first(climap.key_table, argc_caller, argv_caller, args_to_skip);
+            const Step& last = steps_taken.back();
+            DispatchState state;
+            state.argc_callee = argc_caller - last.arg_index;
+            state.argv_callee = argv_caller;
+            std::advance(state.argv_callee, last.arg_index);
+            state.match_index = last.key_index;
+            if (!dispatch_next(climap.key_table, state, last.argc_left_or_error, true)) state.match_index = npos;
+            return state;
+        }
+};
+
+#endif
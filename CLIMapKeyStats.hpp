@@ -0,0 +1,227 @@
+#ifndef CLIMAP_KEY_STATS_HEADER_GUARD
+#define CLIMAP_KEY_STATS_HEADER_GUARD
+
+// Optional per key hit counts of maps' raw arg keys (C string args only), and the key order they
+// suggest. Set the mode at startup, before the maps concerned are constructed (local static maps
+// are constructed on first use):
+//      count:  Count every raw arg key's hits, to dump() as a profile, e.g. at exit.
+//      adapt:  Also try each map's most hit keys first, in a few slots updated as counts change.
+// A profile load()ed at startup reorders the raw arg keys of the maps constructed afterwards, most
+// hit first, in any mode. Either way only keys that could match are reordered, among themselves:
+// raw arg keys never match the same arg, bar duplicates, whose later declarations never match at
+// all and are moved last. Matching functions, noarg and anyarg keep their places, so every lookup
+// has the result it would in declaration order. Maps are told apart in profiles by a hash of their
+// keys; a profile for a map whose keys have changed is ignored. Maps constructed before the first
+// set_mode() or load() are neither counted nor reordered.
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "CLIMap.hpp"
+
+class CLIMapKeyStats {
+    public:
+        enum class Mode {off, count, adapt};
+
+        static void set_mode(Mode mode_in) {
+            mode_slot().store(mode_in, std::memory_order_relaxed);
+            CLIMapKeyCounts::install(freeze);
+        }
+
+        static Mode mode() {
+            return mode_slot().load(std::memory_order_relaxed);
+        }
+
+        // Lines of "map <signature> <key count>" followed by "<key number> <hits> <key>" for each
+        // raw arg key, in declaration order, of every map constructed while counting.
+        static void dump(std::ostream& out) {
+            std::lock_guard<std::mutex> lock(registry_mutex());
+            out << "climap-key-profile 1\n";
+            for (const auto& table: registry()) {
+                std::vector<std::size_t> positions(table->ordinals.size());
+                for (std::size_t position = 0; position != positions.size(); ++position) positions[table->ordinals[position]] = position;
+                out << "map " << std::hex << table->signature << std::dec << ' ' << positions.size() << '\n';
+                for (std::size_t ordinal = 0; ordinal != positions.size(); ++ordinal) {
+                    const std::size_t position = positions[ordinal];
+                    out << ordinal << ' ' << table->hits[position].load(std::memory_order_relaxed) << ' ' << table->keys[position] << '\n';
+                }
+            }
+            out.flush();
+        }
+
+        // Reads a profile written by dump(), summing the counts of maps with the same keys. Returns
+        // false, having loaded nothing, if in is not a profile.
+        static bool load(std::istream& in) {
+            std::string header;
+            int version = 0;
+            if (!(in >> header >> version) || header != "climap-key-profile" || version != 1) return false;
+            std::map<std::uint64_t, std::vector<std::uint64_t>> loaded;
+            std::string word;
+            while (in >> word) {
+                std::uint64_t signature = 0;
+                std::size_t key_count = 0;
+                if (word != "map" || !(in >> std::hex >> signature >> std::dec >> key_count)) return false;
+                std::vector<std::uint64_t>& hits = loaded[signature];
+                if (!hits.empty() && hits.size() != key_count) return false;
+                hits.resize(key_count);
+                for (std::size_t i = 0; i != key_count; ++i) {
+                    std::size_t ordinal = 0;
+                    std::uint64_t key_hits = 0;
+                    if (!(in >> ordinal >> key_hits) || ordinal >= key_count) return false;
+                    in.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+                    hits[ordinal] += key_hits;
+                }
+            }
+            {
+                std::lock_guard<std::mutex> lock(registry_mutex());
+                profile().swap(loaded);
+            }
+            CLIMapKeyCounts::install(freeze);
+            return true;
+        }
+
+    private:
+        using RawArgs = CLIMapRawArgs<const char *>;
+
+        static constexpr std::size_t hot_slot_count = 8;
+        static constexpr std::uint32_t no_position = std::numeric_limits<std::uint32_t>::max();
+
+        struct Table : public CLIMapKeyCounts {
+            // A map's counts, shared by its copies, and kept for dump() once they are all destroyed.
+            Table(std::uint64_t signature_in, std::size_t size, bool adaptive_in):
+                    signature{signature_in}, ordinals(size), keys(size), hits(new std::atomic<std::uint64_t>[size]), adaptive{adaptive_in} {
+                for (std::size_t position = 0; position != size; ++position) hits[position].store(0, std::memory_order_relaxed);
+                for (auto& slot: hot) slot.store(no_position, std::memory_order_relaxed);
+            }
+
+            std::size_t find(const RawArgs& raw_args, const char * arg) override {
+                return find_counted(*this, raw_args, arg);
+            }
+
+            void count(std::size_t position) {
+                hits[position].fetch_add(1, std::memory_order_relaxed);
+            }
+
+            void promote(std::size_t position) {
+                // Takes the slot of the least hit key in the hot slots, if position has since been hit more.
+                const std::uint64_t position_hits = hits[position].load(std::memory_order_relaxed);
+                std::size_t coldest_slot = 0;
+                std::uint64_t coldest_hits = std::numeric_limits<std::uint64_t>::max();
+                for (std::size_t slot = 0; slot != hot_slot_count; ++slot) {
+                    const std::uint32_t slot_position = hot[slot].load(std::memory_order_relaxed);
+                    const std::uint64_t slot_hits = slot_position == no_position ? 0 : hits[slot_position].load(std::memory_order_relaxed);
+                    if (slot_hits < coldest_hits) {
+                        coldest_slot = slot;
+                        coldest_hits = slot_hits;
+                    }
+                }
+                if (position_hits > coldest_hits) hot[coldest_slot].store(static_cast<std::uint32_t>(position), std::memory_order_relaxed);
+            }
+
+            const std::uint64_t signature;
+            std::vector<std::size_t> ordinals;  // Declaration order among raw arg keys, by position.
+            std::vector<std::string> keys;      // By position.
+            std::unique_ptr<std::atomic<std::uint64_t>[]> hits;     // By position.
+            const bool adaptive;
+            std::atomic<std::uint32_t> hot[hot_slot_count];         // Positions of live keys, tried first if adaptive.
+        };
+
+        static CLIMapKeyCounts * freeze(RawArgs& raw_args) {
+            // The freeze hook: orders raw_args' keys by a loaded profile, and starts counting their hits if the mode asks.
+            const std::size_t size = raw_args.size();
+            std::vector<std::size_t> positions(size);
+            for (std::size_t position = 0; position != size; ++position) positions[position] = position;
+            std::vector<std::uint64_t> hits = profiled_hits(raw_args.signature(), size);
+            if (!hits.empty()) {
+                // Later duplicates never match, so count as never hit, and ties keep declaration order.
+                std::vector<std::size_t> by_key(positions);
+                std::sort(by_key.begin(), by_key.end(), [&raw_args](std::size_t lhs, std::size_t rhs) {
+                    const int order = std::strcmp(raw_args.key(lhs), raw_args.key(rhs));
+                    return order < 0 || (order == 0 && lhs < rhs);
+                });
+                for (std::size_t i = 1; i < size; ++i) {
+                    if (std::strcmp(raw_args.key(by_key[i - 1]), raw_args.key(by_key[i])) == 0) hits[by_key[i]] = 0;
+                }
+                std::stable_sort(positions.begin(), positions.end(), [&hits](std::size_t lhs, std::size_t rhs) { return hits[lhs] > hits[rhs]; });
+                raw_args.reorder(positions);
+            }
+            Table * const table = register_table(raw_args.signature(), size);
+            if (table != nullptr) {
+                for (std::size_t position = 0; position != size; ++position) {
+                    table->ordinals[position] = positions[position];
+                    table->keys[position] = raw_args.key(position);
+                }
+            }
+            return table;
+        }
+
+        static std::size_t find_counted(Table& table, const RawArgs& raw_args, const char * arg) {
+            // Hot slots only ever hold keys that matched first, which no other key can match.
+            const std::uint64_t arg_prefix = RawArgs::prefix_of(arg);
+            if (table.adaptive) {
+                for (const auto& slot: table.hot) {
+                    const std::uint32_t position = slot.load(std::memory_order_relaxed);
+                    if (position != no_position && raw_args.matches_at(position, arg, arg_prefix)) {
+                        table.count(position);
+                        return raw_args.key_indices[position];
+                    }
+                }
+            }
+            for (std::size_t i = 0; i != raw_args.size(); ++i) {
+                if (raw_args.matches_at(i, arg, arg_prefix)) {
+                    table.count(i);
+                    if (table.adaptive) table.promote(i);
+                    return raw_args.key_indices[i];
+                }
+            }
+            return RawArgs::npos;
+        }
+
+        static std::atomic<Mode>& mode_slot() {
+            static std::atomic<Mode> mode{Mode::off};
+            return mode;
+        }
+
+        static std::mutex& registry_mutex() {
+            static std::mutex mutex;
+            return mutex;
+        }
+
+        static std::vector<std::unique_ptr<Table>>& registry() {
+            static std::vector<std::unique_ptr<Table>> tables;
+            return tables;
+        }
+
+        static std::map<std::uint64_t, std::vector<std::uint64_t>>& profile() {
+            static std::map<std::uint64_t, std::vector<std::uint64_t>> hits_by_signature;
+            return hits_by_signature;
+        }
+
+        static std::vector<std::uint64_t> profiled_hits(std::uint64_t signature, std::size_t size) {
+            std::lock_guard<std::mutex> lock(registry_mutex());
+            auto found = profile().find(signature);
+            return found != profile().end() && found->second.size() == size ? found->second : std::vector<std::uint64_t>();
+        }
+
+        static Table * register_table(std::uint64_t signature, std::size_t size) {
+            const Mode current_mode = mode();
+            if (current_mode == Mode::off) return nullptr;
+            std::unique_ptr<Table> table(new Table(signature, size, current_mode == Mode::adapt));
+            std::lock_guard<std::mutex> lock(registry_mutex());
+            registry().push_back(std::move(table));
+            return registry().back().get();
+        }
+};
+
+#endif
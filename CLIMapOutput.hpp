@@ -0,0 +1,169 @@
+#ifndef CLIMAP_OUTPUT_HEADER_GUARD
+#define CLIMAP_OUTPUT_HEADER_GUARD
+
+// Optional typed output for CLIMap. Handlers write their results and errors with CLIMapOutput, in
+// the format given to exec_main (see CLIMapOutputWriter), and including this header installs the
+// writer of exec_main's own errors, so that formats other than text may be given:
+//
+//      climap.exec_main(argc, argv, CLIMapOutputFormat::ndjson);
+//
+// Records are written to climap_cout(). In ndjson, records are e.g.
+//      {"type":"result","command":"fact","value":120}
+//      {"type":"error","command":"fact","code":"no_argument"}
+//      {"type":"error","code":"unrecognised_argument","index":3,"argument":"bogus"}
+// the last being one of the errors exec_main reports itself, which have no command. In binary, a
+// record is its payload's length as a little endian uint32, then the payload: a type byte (0 for
+// a result, 1 for an error), then each field as its name's length byte and name, and a kind byte,
+// 'i' followed by a little endian int64, or 's' followed by a little endian uint32 length and the
+// bytes. Records are written straight to the stream, field by field.
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+
+#include "CLIMap.hpp"
+
+class CLIMapOutput : public CLIMapOutputWriter {
+    public:
+        // In text, the value alone on a line, as handlers print results.
+        static void result(const char * command, long long value) {
+            if (format() == CLIMapOutputFormat::text) {
+                climap_cout() << value << '\n';
+                return;
+            }
+            const Field fields[] {{"command", command}, {"value", value}};
+            write(RecordType::result, fields, 2);
+        }
+
+        static void result(const char * command, const char * value) {
+            if (format() == CLIMapOutputFormat::text) {
+                climap_cout() << value << '\n';
+                return;
+            }
+            const Field fields[] {{"command", command}, {"value", value}};
+            write(RecordType::result, fields, 2);
+        }
+
+        // Returns false in text, having written nothing, so that the handler prints its own message:
+        //      if (!CLIMapOutput::error("fact", "no_argument")) climap_cout() << "No argument provided to fact command." << endl;
+        static bool error(const char * command, const char * code, const char * argument = nullptr) {
+            if (format() == CLIMapOutputFormat::text) return false;
+            const Field fields[] {{"command", command}, {"code", code}, {"argument", argument}};
+            write(RecordType::error, fields, argument != nullptr ? 3 : 2);
+            return true;
+        }
+
+        static bool install() {
+            static CLIMapOutput writer;
+            return CLIMapOutputWriter::install(&writer);
+        }
+
+        void write_invalid_argument() override {
+            const Field fields[] {{"code", "invalid_argument"}};
+            write(RecordType::error, fields, 1);
+        }
+
+        void write_unrecognised_argument(long long index, const char * argument) override {
+            const Field fields[] {{"code", "unrecognised_argument"}, {"index", index}, {"argument", argument}};
+            write(RecordType::error, fields, argument != nullptr ? 3 : 2);
+        }
+
+    private:
+        enum class RecordType : unsigned char { result = 0, error = 1 };
+
+        struct Field {
+            constexpr Field(const char * name_in, const char * string_in): name{name_in}, string{string_in}, integer{0} { }
+            constexpr Field(const char * name_in, long long integer_in): name{name_in}, string{nullptr}, integer{integer_in} { }
+
+            const char * name;
+            const char * string;    // nullptr for an integer field.
+            long long integer;
+        };
+
+        static void write(RecordType type, const Field * fields, std::size_t field_count) {
+            std::ostream& out = climap_cout();
+            if (format() == CLIMapOutputFormat::ndjson) {
+                out.write(type == RecordType::result ? "{\"type\":\"result\"" : "{\"type\":\"error\"", type == RecordType::result ? 16 : 15);
+                for (std::size_t i = 0; i != field_count; ++i) {
+                    out.put(',');
+                    write_json_string(out, fields[i].name);
+                    out.put(':');
+                    if (fields[i].string != nullptr) {
+                        write_json_string(out, fields[i].string);
+                    } else {
+                        write_decimal(out, fields[i].integer);
+                    }
+                }
+                out.write("}\n", 2);
+            } else {
+                std::uint32_t payload_length = 1;
+                for (std::size_t i = 0; i != field_count; ++i) {
+                    payload_length += 2 + static_cast<std::uint32_t>(std::strlen(fields[i].name));
+                    payload_length += fields[i].string != nullptr ? 4 + static_cast<std::uint32_t>(std::strlen(fields[i].string)) : 8;
+                }
+                write_little_endian(out, payload_length, 4);
+                out.put(static_cast<char>(type));
+                for (std::size_t i = 0; i != field_count; ++i) {
+                    const std::size_t name_length = std::strlen(fields[i].name);
+                    out.put(static_cast<char>(name_length));
+                    out.write(fields[i].name, name_length);
+                    if (fields[i].string != nullptr) {
+                        const std::size_t length = std::strlen(fields[i].string);
+                        out.put('s');
+                        write_little_endian(out, length, 4);
+                        out.write(fields[i].string, length);
+                    } else {
+                        out.put('i');
+                        write_little_endian(out, static_cast<unsigned long long>(fields[i].integer), 8);
+                    }
+                }
+            }
+        }
+
+        static void write_little_endian(std::ostream& out, unsigned long long value, int bytes) {
+            char buffer[8];
+            for (int i = 0; i != bytes; ++i) buffer[i] = static_cast<char>(value >> 8*i);
+            out.write(buffer, bytes);
+        }
+
+        static void write_decimal(std::ostream& out, long long value) {
+            char buffer[20];
+            char * digits = buffer + sizeof buffer;
+            unsigned long long magnitude = value < 0 ? 0 - static_cast<unsigned long long>(value) : value;
+            do {
+                *--digits = static_cast<char>('0' + magnitude%10);
+                magnitude /= 10;
+            } while (magnitude != 0);
+            if (value < 0) *--digits = '-';
+            out.write(digits, buffer + sizeof buffer - digits);
+        }
+
+        static void write_json_string(std::ostream& out, const char * string) {
+            // UTF-8 passes through; quotes, backslashes and control characters are escaped.
+            static const char hex_digits[] = "0123456789abcdef";
+            out.put('"');
+            const char * run = string;
+            for (const char * c = string; *c != '\0'; ++c) {
+                const unsigned char byte = static_cast<unsigned char>(*c);
+                if (byte >= 0x20 && byte != '"' && byte != '\\') continue;
+                out.write(run, c - run);
+                run = c + 1;
+                if (byte == '"' || byte == '\\') {
+                    const char escape[] {'\\', static_cast<char>(byte)};
+                    out.write(escape, 2);
+                } else {
+                    const char escape[] {'\\', 'u', '0', '0', hex_digits[byte >> 4], hex_digits[byte & 0xf]};
+                    out.write(escape, 6);
+                }
+            }
+            out.write(run, std::strlen(run));
+            out.put('"');
+        }
+};
+
+namespace {
+    const bool climap_output_installed = CLIMapOutput::install();
+}
+
+#endif
@@ -0,0 +1,301 @@
+#ifndef CLIMAP_PARALLEL_HEADER_GUARD
+#define CLIMAP_PARALLEL_HEADER_GUARD
+
+// Optional parallel dispatch for CLIMap. Installing a CLIMapThreadPool runs the handlers of keys
+// marked climap_speculative concurrently, with their output reassembled in command line order.
+// Including this header installs one if the CLIMAP_WORKERS environment variable is set, to a thread
+// count or to "auto" for one thread per core. Or install one yourself:
+//
+//      CLIMapThreadPool pool;
+//      CLIMapWorkers::install(&pool);
+//      ...
+//      static const CLIMap<> climap {
+//          {"fact", climap_speculative(fact_main)},
+//          ...
+//      };
+//
+// so that "prog fizzbuzz 15 fact 12 fizzbuzz 40" prints what it would sequentially, in about the time of
+// its slowest subcommand. See CLIMapWorkers for what speculative handlers may and may not do.
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "CLIMap.hpp"
+
+class CLIMapWorkers {
+    // Runs the handlers of keys marked climap_speculative concurrently, e.g. a CLIMapThreadPool. While
+    // workers are installed, exec launches a speculative handler as soon as it matches, predicts that
+    // it takes the arguments up to the next one matching a raw arg key of the same map, and carries
+    // on dispatching from there. Handlers' output to climap_cout() is captured, and written in command
+    // line order once each handler has finished as predicted. The handlers launched after one that
+    // did not are discarded, output and all, and dispatch carries on from where it really finished,
+    // so a speculative handler may be called where it would not have been sequentially. Speculative
+    // handlers must therefore have no effect beyond their output to climap_cout(). Other handlers are
+    // only called once the handlers before them have finished, at the position dispatch would call
+    // them sequentially. Maps executed by speculative handlers, and maps executed while profiling,
+    // dispatch sequentially.
+    public:
+        class Task {
+            public:
+                virtual ~Task() { }
+                virtual void run() = 0;
+        };
+
+        virtual ~CLIMapWorkers() { }
+
+        virtual void submit(Task& task) = 0;    // Calls task.run() on some thread.
+        virtual void wait(Task& task) = 0;      // Returns once task.run() has returned.
+
+        static bool install(CLIMapWorkers * workers) {
+            active_slot().store(workers, std::memory_order_release);
+            return true;
+        }
+
+        static CLIMapWorkers * active() {
+            return active_slot().load(std::memory_order_acquire);
+        }
+
+    private:
+        static std::atomic<CLIMapWorkers *>& active_slot() {
+            static std::atomic<CLIMapWorkers *> active_workers{nullptr};
+            return active_workers;
+        }
+};
+
+template<typename Marks>
+struct CLIMapSpeculative : Marks {  // climap_speculative's, which executes the handler's map through ParallelDispatch.
+    template<typename Map>
+    static constexpr auto exec_hook() -> decltype(&Map::ParallelDispatch::exec) {
+        return &Map::ParallelDispatch::exec;
+    }
+};
+
+template<typename ArgIterator, typename Marks>
+constexpr CLIMapMarkedHandler<ArgIterator, CLIMapSpeculative<Marks>> climap_speculative(CLIMapMarkedHandler<ArgIterator, Marks> marked) {
+    return CLIMapMarkedHandler<ArgIterator, CLIMapSpeculative<Marks>>{marked.function};
+}
+
+template<typename ArgIterator>
+constexpr CLIMapMarkedHandler<ArgIterator, CLIMapSpeculative<CLIMapUnmarked>> climap_speculative(int (*function)(int, ArgIterator)) {
+    // Marks a handler that has no effect beyond its output and shares no state with other handlers,
+    // e.g. {"fact", climap_speculative(fact_main)}, so that it may be launched on another thread ahead
+    // of the handlers before it, and discarded; see CLIMapWorkers.
+    return CLIMapMarkedHandler<ArgIterator, CLIMapSpeculative<CLIMapUnmarked>>{function};
+}
+
+template<typename ArgType, typename MatchFnType, typename ArgIterator>
+class CLIMap<ArgType, MatchFnType, ArgIterator>::ParallelDispatch {
+    // exec_base for maps with speculative handlers, launching them on workers without waiting for those before them.
+    public:
+        static int exec(const CLIMap& climap, int argc_caller, ArgIterator argv_caller, int args_to_skip, bool match_on_anyarg_in_loop) {
+            // Looking ahead of handlers takes an array of arguments, and maps executed by handlers whose
+            // output is captured dispatch sequentially.
+            CLIMapWorkers * const workers = std::is_pointer<ArgIterator>::value && climap_captured_output() == nullptr ? CLIMapWorkers::active() : nullptr;
+            if (workers == nullptr) return climap.exec_sequential(argc_caller, argv_caller, args_to_skip, match_on_anyarg_in_loop);
+
+            std::deque<Call> calls;     // In command line order. A deque never relocates them while workers run them.
+            DispatchState state = dispatch_first(climap.key_table, argc_caller, argv_caller, args_to_skip);
+            bool more_to_do = state.match_index != npos;
+            try {
+                while (more_to_do) {
+                    const Handler& handler = climap.handlers[state.match_index];
+                    if (handler.exec_hook == &exec) {   // Speculative.
+                        calls.emplace_back(climap, handler, state, match_on_anyarg_in_loop);
+                        workers->submit(calls.back());
+                        if (!dispatch_predicted(climap, state, match_on_anyarg_in_loop)) more_to_do = resolve_calls(climap, *workers, calls, state, false, match_on_anyarg_in_loop);
+                    } else if (!calls.empty()) {
+                        more_to_do = resolve_calls(climap, *workers, calls, state, true, match_on_anyarg_in_loop);    // Then match again, as state may have moved.
+                    } else {
+                        more_to_do = dispatch_next(climap.key_table, state, climap.call(handler, state, match_on_anyarg_in_loop), match_on_anyarg_in_loop);
+                    }
+                }
+            } catch (...) {
+                for (auto& call: calls) workers->wait(call);
+                throw;
+            }
+            return state.argc_left_or_error;
+        }
+
+    private:
+        class Call : public CLIMapWorkers::Task {
+            // A speculative handler's call, as launched by exec.
+            public:
+                Call(const CLIMap& climap_in, const Handler& handler_in, const DispatchState& state_in, bool match_on_anyarg_in_loop_in):
+                        climap(climap_in), handler(handler_in), state(state_in), match_on_anyarg_in_loop{match_on_anyarg_in_loop_in}, format{CLIMapOutputWriter::format()} { }
+
+                void run() override {
+                    std::ostream *& captured = climap_captured_output();
+                    std::ostream * const outer_captured = captured;
+                    captured = &output;
+                    CLIMapOutputWriter::Scope format_scope(format);
+                    try {
+                        result = climap.call(handler, state, match_on_anyarg_in_loop);
+                    } catch (...) {
+                        exception = std::current_exception();
+                    }
+                    captured = outer_captured;
+                }
+
+                const CLIMap& climap;
+                const Handler& handler;
+                DispatchState state;    // As when the call was launched.
+                bool match_on_anyarg_in_loop;
+                CLIMapOutputFormat format;
+                int result = ARGMAP_EXIT_INVALID_ARG;
+                std::exception_ptr exception;
+                std::ostringstream output;
+        };
+
+        static bool dispatch_predicted(const CLIMap& climap, DispatchState& state, bool match_on_anyarg_in_loop) {
+            // Moves state on to the next argument matching a raw arg key, where the speculative handler
+            // just launched is predicted to finish. Returns false, leaving state as it was, if there is none.
+            // The predicted key is that raw arg key: matching functions are only called, and hits only
+            // counted, once resolve_calls gets there, as sequential dispatch would.
+            ArgIterator arg = state.argv_callee;
+            for (int argc_left = state.argc_callee - 1; argc_left > 0; --argc_left) {
+                std::advance(arg, 1);
+                const std::size_t raw_arg_index = climap.key_table.find_raw_arg(*arg);
+                if (raw_arg_index != npos) {
+                    state.argc_callee = argc_left;
+                    state.argv_callee = arg;
+                    state.match_index = raw_arg_index;
+                    state.argc_left_or_error = argc_left;
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        static bool resolve_calls(const CLIMap& climap, CLIMapWorkers& workers, std::deque<Call>& calls, DispatchState& state, bool state_predicted, bool match_on_anyarg_in_loop) {
+            // Waits for calls in order, writing their output, until one finishes other than predicted, at
+            // another argument or one matching another key. Leaves state where dispatch really carries on,
+            // as matched by dispatch_next, and returns false if there is nothing more to do.
+            // state_predicted is whether state is the prediction for the last call.
+            bool more_to_do = state_predicted;
+            for (std::size_t i = 0; i != calls.size(); ++i) {
+                Call& call = calls[i];
+                workers.wait(call);
+                if (call.exception) {
+                    for (std::size_t j = i + 1; j != calls.size(); ++j) workers.wait(calls[j]);
+                    std::exception_ptr exception = call.exception;
+                    calls.clear();
+                    std::rethrow_exception(exception);
+                }
+                climap_cout() << call.output.str();
+
+                DispatchState actual = call.state;
+                bool actual_more_to_do = dispatch_next(climap.key_table, actual, call.result, match_on_anyarg_in_loop);
+                const bool last = i + 1 == calls.size();
+                const bool predicted = last ? state_predicted : true;
+                const DispatchState& prediction = last ? state : calls[i + 1].state;
+                if (!predicted || !actual_more_to_do || actual.argc_callee != prediction.argc_callee || actual.match_index != prediction.match_index) {
+                    for (std::size_t j = i + 1; j != calls.size(); ++j) workers.wait(calls[j]);    // Discarded.
+                    state = actual;
+                    more_to_do = actual_more_to_do;
+                    break;
+                }
+                if (last) state = actual;
+            }
+            calls.clear();
+            return more_to_do;
+        }
+};
+
+class CLIMapThreadPool : public CLIMapWorkers {
+    public:
+        explicit CLIMapThreadPool(unsigned thread_count = std::thread::hardware_concurrency()) {
+            if (thread_count == 0) thread_count = 1;
+            for (unsigned i = 0; i != thread_count; ++i) threads.emplace_back([this] { work(); });
+        }
+
+        CLIMapThreadPool(const CLIMapThreadPool&) = delete;
+        CLIMapThreadPool& operator=(const CLIMapThreadPool&) = delete;
+
+        ~CLIMapThreadPool() {
+            if (CLIMapWorkers::active() == this) CLIMapWorkers::install(nullptr);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopping = true;
+            }
+            task_queued.notify_all();
+            for (auto& thread: threads) thread.join();
+        }
+
+        void submit(Task& task) override {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                queued.push_back(&task);
+            }
+            task_queued.notify_one();
+        }
+
+        void wait(Task& task) override {
+            std::unique_lock<std::mutex> lock(mutex);
+            auto queued_task = std::find(queued.begin(), queued.end(), &task);
+            if (queued_task != queued.end()) {
+                queued.erase(queued_task);  // Not started, so run it here rather than wait for a thread.
+                lock.unlock();
+                task.run();
+                return;
+            }
+            task_finished.wait(lock, [&] { return std::find(running.begin(), running.end(), &task) == running.end(); });
+        }
+
+    private:
+        std::mutex mutex;
+        std::condition_variable task_queued;
+        std::condition_variable task_finished;
+        std::deque<Task *> queued;
+        std::vector<Task *> running;
+        bool stopping = false;
+        std::vector<std::thread> threads;
+
+        void work() {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (true) {
+                task_queued.wait(lock, [this] { return stopping || !queued.empty(); });
+                if (queued.empty()) return;
+                Task * task = queued.front();
+                queued.pop_front();
+                running.push_back(task);
+
+                lock.unlock();
+                task->run();
+                lock.lock();
+
+                running.erase(std::find(running.begin(), running.end(), task));
+                task_finished.notify_all();
+            }
+        }
+};
+
+inline bool climap_workers_from_environment() {
+    // Installs a thread pool of CLIMAP_WORKERS threads, if set to a thread count or "auto".
+    static const char * threads = std::getenv("CLIMAP_WORKERS");
+    if (threads == nullptr || *threads == '\0') return false;
+    unsigned thread_count = std::thread::hardware_concurrency();
+    if (std::strcmp(threads, "auto") != 0) {
+        char * end;
+        const unsigned long count = std::strtoul(threads, &end, 10);
+        if (*end != '\0' || count == 0 || count > 1024) return false;
+        thread_count = static_cast<unsigned>(count);
+    }
+    static CLIMapThreadPool pool(thread_count);
+    return CLIMapWorkers::install(&pool);
+}
+
+namespace {
+    const bool climap_thread_pool_installed = climap_workers_from_environment();
+}
+
+#endif
@@ -0,0 +1,90 @@
+#ifndef CLIMAP_PLUGIN_HEADER_GUARD
+#define CLIMAP_PLUGIN_HEADER_GUARD
+
+// Optional lazily loaded handlers for CLIMap. A CLIMapPlugin names a handler in a shared object,
+// which is opened with dlopen, and the handler found with dlsym, only when a key first matches it.
+// The handler is cached thereafter.
+//
+//      namespace {
+//          CLIMapPlugin<> report_plugin("libreport.so", "report_main");
+//      }
+//      ...
+//      static const CLIMap<> climap {
+//          {"report", CLIMapPlugin<>::handler<report_plugin>},
+//          ...
+//      };
+//
+// A program with many rarely used subcommands so avoids loading, relocating and initialising the
+// code of those it does not run. The library is found as dlopen finds it (a bare name is searched
+// for on LD_LIBRARY_PATH and the program's RUNPATH), and the handler must be declared extern "C"
+// there, with the usual handler signature. A plugin's handler may execute CLIMaps of its own, so one
+// plugin can bring a whole nested command tree. Libraries are never unloaded.
+//
+// If the library or handler cannot be found, the dispatch that matched it throws std::runtime_error
+// with dlerror's message, and loading is tried again on the next match.
+
+#include <atomic>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+
+#include <dlfcn.h>
+
+#include "CLIMap.hpp"
+
+template<typename ArgIterator = CLIMapDT::ArgIterator>
+class CLIMapPlugin {
+    public:
+        using HandlerType = int (*)(int, ArgIterator);
+
+        // Constant initialised, so a plugin may be used by maps in other static initialisers.
+        constexpr CLIMapPlugin(const char * library_in, const char * symbol_in): library{library_in}, symbol{symbol_in} { }
+
+        CLIMapPlugin(const CLIMapPlugin&) = delete;
+        CLIMapPlugin& operator=(const CLIMapPlugin&) = delete;
+
+        // The handler to give a key. plugin must have static storage duration, and until c++17,
+        // be declared at namespace scope.
+        template<CLIMapPlugin& plugin>
+        static int handler(int argc, ArgIterator argv) {
+            return plugin.resolve()(argc, argv);
+        }
+
+        HandlerType resolve() {
+            HandlerType resolved = resolved_handler.load(std::memory_order_acquire);
+            return resolved != nullptr ? resolved : load();
+        }
+
+        bool loaded() const {
+            return resolved_handler.load(std::memory_order_acquire) != nullptr;
+        }
+
+    private:
+        const char * library;
+        const char * symbol;
+        std::atomic<HandlerType> resolved_handler{nullptr};
+        std::mutex load_mutex;
+
+        HandlerType load() {
+            std::lock_guard<std::mutex> lock(load_mutex);
+            HandlerType resolved = resolved_handler.load(std::memory_order_relaxed);
+            if (resolved != nullptr) return resolved;
+
+            void * library_handle = dlopen(library, RTLD_NOW | RTLD_LOCAL);
+            if (library_handle == nullptr) throw std::runtime_error(std::string("CLIMap plugin: ") + dlerror());
+            dlerror();
+            void * address = dlsym(library_handle, symbol);
+            const char * error = dlerror();
+            if (error != nullptr || address == nullptr) {
+                std::string message = std::string("CLIMap plugin: ") + (error != nullptr ? error : "null handler") + ".";
+                dlclose(library_handle);
+                throw std::runtime_error(message);
+            }
+
+            resolved = reinterpret_cast<HandlerType>(address);
+            resolved_handler.store(resolved, std::memory_order_release);
+            return resolved;
+        }
+};
+
+#endif
@@ -0,0 +1,284 @@
+#ifndef CLIMAP_PROFILE_HEADER_GUARD
+#define CLIMAP_PROFILE_HEADER_GUARD
+
+// Optional profiling mode for CLIMap. Including this header installs CLIMapPerfProfiler, so that
+// running the program with CLIMAP_PROFILE_SWITCH ("--climap-profile") as its first argument
+// measures every key matching step and every handler call, and prints a table to std::cerr at exit.
+//
+// On Linux each thread counts cycles, instructions, branch misses and last level cache misses with
+// perf_event_open (user space only). Where the counters are unavailable (other platforms, or
+// perf_event_paranoid forbids them) only clock_gettime time is reported. Counts are self counts:
+// a handler's row excludes the matching and handlers of any maps it executes.
+//
+// Handlers are named with dladdr, so link the program with -rdynamic (CMake ENABLE_EXPORTS) for
+// names rather than addresses.
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <time.h>
+
+#if defined(__linux__)
+    #include <linux/perf_event.h>
+    #include <sys/syscall.h>
+    #include <unistd.h>
+#endif
+
+#include "CLIMap.hpp"
+
+class CLIMapPerfProfiler : public CLIMapProfiler {
+    public:
+        static CLIMapPerfProfiler& instance() {
+            static CLIMapPerfProfiler profiler;
+            static const bool report_registered = std::atexit(report_at_exit) == 0;    // After construction, so it runs before destruction.
+            (void) report_registered;
+            return profiler;
+        }
+
+        void begin_phase() override {
+            ThreadState& thread = thread_state();
+            thread.stack.push_back(Frame());
+            read_counters(thread, thread.stack.back().start);
+        }
+
+        void end_matching_phase() override {
+            ThreadState& thread = thread_state();
+            add_to_row(thread.matching_row, end_phase(thread));
+        }
+
+        void end_handler_phase(HandlerId handler) override {
+            ThreadState& thread = thread_state();
+            Sample self = end_phase(thread);
+            add_to_row(handler_row(thread, handler), self);
+        }
+
+    private:
+        enum Counter {cycles, instructions, branch_misses, llc_misses, nanoseconds, counter_count};
+        static constexpr int hardware_counter_count = nanoseconds;
+        static constexpr std::size_t table_size = 256;  // Handler rows per thread; handlers beyond share the overflow row.
+
+        struct Sample {
+            std::uint64_t values[counter_count] = {};
+        };
+
+        struct Frame {
+            Sample start;
+            Sample children;
+        };
+
+        struct Row {
+            // Written by the owning thread only, and read by the exit report, hence relaxed atomics.
+            std::atomic<HandlerId> handler{nullptr};
+            std::atomic<std::uint64_t> calls{0};
+            std::atomic<std::uint64_t> totals[counter_count];
+
+            Row() {
+                for (auto& total: totals) total.store(0, std::memory_order_relaxed);
+            }
+        };
+
+        struct ThreadState {
+            int group_fd = -1;
+            int event_fds[hardware_counter_count] = {-1, -1, -1, -1};
+            int event_positions[hardware_counter_count] = {-1, -1, -1, -1};    // In a PERF_FORMAT_GROUP read, -1 if unavailable.
+            int events_open = 0;
+            std::vector<Frame> stack;
+            Row rows[table_size];
+            Row overflow_row;
+            Row matching_row;
+            ThreadState * next = nullptr;
+        };
+
+        class ThreadStateHolder {
+            // Closes the thread's counters when it exits. Its rows stay on the list for the exit report.
+            public:
+                ThreadState * state = nullptr;
+                ~ThreadStateHolder() {
+                    #if defined(__linux__)
+                        if (state != nullptr) {
+                            for (int fd: state->event_fds) {
+                                if (fd != -1) close(fd);
+                            }
+                        }
+                    #endif
+                }
+        };
+
+        std::atomic<ThreadState *> threads{nullptr};
+
+        CLIMapPerfProfiler() = default;
+
+        ThreadState& thread_state() {
+            static thread_local ThreadStateHolder holder;
+            if (holder.state == nullptr) {
+                ThreadState * state = new ThreadState();    // Never freed, see ThreadStateHolder.
+                open_counters(*state);
+                state->next = threads.load(std::memory_order_relaxed);
+                while (!threads.compare_exchange_weak(state->next, state, std::memory_order_release, std::memory_order_relaxed)) { }
+                holder.state = state;
+            }
+            return *holder.state;
+        }
+
+        static void open_counters(ThreadState& thread) {
+            #if defined(__linux__)
+                const std::uint32_t types[hardware_counter_count] = {PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE};
+                const std::uint64_t configs[hardware_counter_count] = {
+                    PERF_COUNT_HW_CPU_CYCLES,
+                    PERF_COUNT_HW_INSTRUCTIONS,
+                    PERF_COUNT_HW_BRANCH_MISSES,
+                    PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)
+                };
+                for (int counter = 0; counter != hardware_counter_count; ++counter) {
+                    perf_event_attr attr = {};
+                    attr.size = sizeof(attr);
+                    attr.type = types[counter];
+                    attr.config = configs[counter];
+                    attr.exclude_kernel = 1;
+                    attr.exclude_hv = 1;
+                    attr.read_format = PERF_FORMAT_GROUP;
+                    int fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, thread.group_fd, 0));
+                    if (fd == -1) continue;
+                    if (thread.group_fd == -1) thread.group_fd = fd;
+                    thread.event_fds[counter] = fd;
+                    thread.event_positions[counter] = thread.events_open++;
+                }
+            #else
+                (void) thread;
+            #endif
+        }
+
+        static void read_counters(ThreadState& thread, Sample& sample) {
+            timespec now;
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            sample.values[nanoseconds] = static_cast<std::uint64_t>(now.tv_sec) * 1000000000u + static_cast<std::uint64_t>(now.tv_nsec);
+            #if defined(__linux__)
+                if (thread.group_fd == -1) return;
+                std::uint64_t group[1 + hardware_counter_count];
+                if (read(thread.group_fd, group, sizeof(std::uint64_t) * (1 + thread.events_open)) <= 0) return;
+                for (int counter = 0; counter != hardware_counter_count; ++counter) {
+                    if (thread.event_positions[counter] != -1) sample.values[counter] = group[1 + thread.event_positions[counter]];
+                }
+            #endif
+        }
+
+        static Sample end_phase(ThreadState& thread) {
+            // Pops the innermost phase, returning its self counts and charging its total to its parent.
+            Sample now;
+            read_counters(thread, now);
+            Frame frame = thread.stack.back();
+            thread.stack.pop_back();
+
+            Sample self;
+            for (int counter = 0; counter != counter_count; ++counter) {
+                std::uint64_t total = now.values[counter] - frame.start.values[counter];
+                self.values[counter] = total - frame.children.values[counter];
+                if (!thread.stack.empty()) thread.stack.back().children.values[counter] += total;
+            }
+            return self;
+        }
+
+        static Row& handler_row(ThreadState& thread, HandlerId handler) {
+            std::size_t hash = reinterpret_cast<std::uintptr_t>(handler) >> 4;
+            for (std::size_t probe = 0; probe != table_size; ++probe) {
+                Row& row = thread.rows[(hash + probe) % table_size];
+                HandlerId row_handler = row.handler.load(std::memory_order_relaxed);
+                if (row_handler == handler) return row;
+                if (row_handler == nullptr) {
+                    row.handler.store(handler, std::memory_order_release);
+                    return row;
+                }
+            }
+            return thread.overflow_row;
+        }
+
+        static void add_to_row(Row& row, const Sample& self) {
+            row.calls.store(row.calls.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            for (int counter = 0; counter != counter_count; ++counter) {
+                row.totals[counter].store(row.totals[counter].load(std::memory_order_relaxed) + self.values[counter], std::memory_order_relaxed);
+            }
+        }
+
+        struct ReportLine {
+            HandlerId handler;
+            std::uint64_t calls;
+            std::uint64_t totals[counter_count];
+        };
+
+        static void add_to_report(std::vector<ReportLine>& report, HandlerId handler, const Row& row) {
+            std::uint64_t calls = row.calls.load(std::memory_order_relaxed);
+            if (calls == 0) return;
+            ReportLine * line = nullptr;
+            for (auto& existing: report) {
+                if (existing.handler == handler) line = &existing;
+            }
+            if (line == nullptr) {
+                report.push_back(ReportLine{handler, 0, {}});
+                line = &report.back();
+            }
+            line->calls += calls;
+            for (int counter = 0; counter != counter_count; ++counter) line->totals[counter] += row.totals[counter].load(std::memory_order_relaxed);
+        }
+
+        static void print_line(const char * name, const ReportLine& line, bool counters_available[hardware_counter_count]) {
+            std::fprintf(stderr, "%-40.40s %10llu %14llu", name, static_cast<unsigned long long>(line.calls), static_cast<unsigned long long>(line.totals[nanoseconds]));
+            for (int counter = 0; counter != hardware_counter_count; ++counter) {
+                if (counters_available[counter]) {
+                    std::fprintf(stderr, " %14llu", static_cast<unsigned long long>(line.totals[counter]));
+                } else {
+                    std::fprintf(stderr, " %14s", "n/a");
+                }
+            }
+            std::fprintf(stderr, "\n");
+        }
+
+        static void report_at_exit() {
+            CLIMapPerfProfiler& profiler = instance();
+            if (CLIMapProfiler::active() != &profiler) return;
+
+            static const HandlerId matching_id = reinterpret_cast<HandlerId>(&report_at_exit);   // Stands in for a handler in the report.
+            static const HandlerId overflow_id = reinterpret_cast<HandlerId>(&open_counters);
+            std::vector<ReportLine> report;
+            bool counters_available[hardware_counter_count] = {};
+            for (ThreadState * thread = profiler.threads.load(std::memory_order_acquire); thread != nullptr; thread = thread->next) {
+                for (int counter = 0; counter != hardware_counter_count; ++counter) counters_available[counter] |= thread->event_positions[counter] != -1;
+                add_to_report(report, matching_id, thread->matching_row);
+                for (const auto& row: thread->rows) add_to_report(report, row.handler.load(std::memory_order_acquire), row);
+                add_to_report(report, overflow_id, thread->overflow_row);
+            }
+
+            std::fflush(stdout);
+            std::fprintf(stderr, "\nCLIMap profile (self counts)\n%-40s %10s %14s %14s %14s %14s %14s\n", "phase", "calls", "ns", "cycles", "instructions", "branch-misses", "llc-misses");
+            for (const auto& line: report) {
+                if (line.handler == matching_id) {
+                    print_line("key matching", line, counters_available);
+                } else if (line.handler == overflow_id) {
+                    print_line("other handlers", line, counters_available);
+                } else {
+                    char address[2 + 2*sizeof(void *) + 1];
+                    std::snprintf(address, sizeof(address), "%p", reinterpret_cast<void *>(line.handler));
+                    Dl_info info;
+                    const char * name = address;
+                    char * demangled = nullptr;
+                    if (dladdr(reinterpret_cast<void *>(line.handler), &info) != 0 && info.dli_sname != nullptr) {
+                        int status;
+                        demangled = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+                        name = demangled != nullptr ? demangled : info.dli_sname;
+                    }
+                    print_line(name, line, counters_available);
+                    std::free(demangled);
+                }
+            }
+        }
+};
+
+namespace {
+    const bool climap_perf_profiler_installed = CLIMapProfiler::install(&CLIMapPerfProfiler::instance());
+}
+
+#endif
@@ -0,0 +1,343 @@
+#ifndef CLIMAP_RECORD_HEADER_GUARD
+#define CLIMAP_RECORD_HEADER_GUARD
+
+// Optional record-and-replay of the command lines exec_main processes, for benchmarking CLIMap
+// trees against a real workload mix. Including this header installs a CLIMapLogRecorder if the
+// CLIMAP_RECORD environment variable names a log file, which is then appended to.
+//
+// The log is a sequence of blocks, each written with a single append so that concurrent processes
+// may share a log. A block is a header (CLIMAP_LOG_BLOCK_MAGIC, payload size, session id) followed
+// by records. A session is one recorder's stream of records, and numbers the distinct strings it
+// has seen, so that each string is written once and commands refer to it by index:
+//
+//      session start:  CLIMAP_LOG_SESSION_START, start time (fixed 8 bytes, ns since the epoch)
+//      string:         CLIMAP_LOG_STRING, length, bytes
+//      command:        CLIMAP_LOG_COMMAND, ns since the last command, args_to_skip, argc, argc string indices
+//
+// Unless marked fixed, integers are unsigned LEB128 varints. Fixed integers are little endian.
+//
+// CLIMapReplayLog reads a log back, and climap_replay feeds it through a CLIMap tree, reporting
+// throughput and a histogram of per-command latency.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <iterator>
+#include <mutex>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "CLIMap.hpp"
+
+constexpr std::uint32_t CLIMAP_LOG_BLOCK_MAGIC = 0x42524c43;   // "CLRB"
+constexpr unsigned char CLIMAP_LOG_SESSION_START = 1;
+constexpr unsigned char CLIMAP_LOG_STRING = 2;
+constexpr unsigned char CLIMAP_LOG_COMMAND = 3;
+
+class CLIMapLogRecorder : public CLIMapRecorder {
+    public:
+        explicit CLIMapLogRecorder(const char * path): fd{open(path, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644)} {
+            if (fd == -1) throw std::runtime_error(std::string("CLIMapLogRecorder could not open \"") + path + "\".");
+            start_session();
+        }
+
+        CLIMapLogRecorder(const CLIMapLogRecorder&) = delete;
+        CLIMapLogRecorder& operator=(const CLIMapLogRecorder&) = delete;
+
+        ~CLIMapLogRecorder() {
+            CLIMapRecorder::install(nullptr);   // Assumes this is the installed recorder, as it is for climap_record_from_environment.
+            flush();
+            close(fd);
+        }
+
+        void record(int argc, const char * const * argv, int args_to_skip) override {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (strings.size() + static_cast<std::size_t>(argc) > max_session_strings) {
+                flush_locked();
+                start_session();
+            }
+
+            // Look every argument up first, so that new strings precede the command that uses them.
+            indices.clear();
+            for (int i = 0; i != argc; ++i) indices.push_back(string_index(argv[i]));
+
+            std::uint64_t now = now_ns();
+            payload.push_back(CLIMAP_LOG_COMMAND);
+            put_varint(now - last_command_ns);
+            put_varint(static_cast<std::uint64_t>(args_to_skip));
+            put_varint(static_cast<std::uint64_t>(argc));
+            for (std::uint32_t index: indices) put_varint(index);
+            last_command_ns = now;
+            ++commands_pending;
+
+            if (payload.size() >= flush_size) flush_locked();
+        }
+
+        void flush() {
+            std::lock_guard<std::mutex> lock(mutex);
+            flush_locked();
+        }
+
+    private:
+        static constexpr std::size_t flush_size = 1 << 16;
+        static constexpr std::size_t max_session_strings = 1 << 16;    // Bounds the string table; a new session starts a new one.
+
+        int fd;
+        std::mutex mutex;
+        std::uint64_t session_id = 0;
+        std::uint64_t last_command_ns = 0;
+        std::vector<unsigned char> payload;
+        std::vector<std::string> strings;
+        std::unordered_map<std::uint64_t, std::vector<std::uint32_t>> string_indices_by_hash;
+        std::vector<std::uint32_t> indices;
+        std::size_t commands_pending = 0;   // Blocks without commands are not worth writing.
+
+        static std::uint64_t now_ns() {
+            return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count());
+        }
+
+        static std::uint64_t hash_of(const char * str, std::size_t length) {   // FNV-1a
+            std::uint64_t hash = 14695981039346656037u;
+            for (std::size_t i = 0; i != length; ++i) {
+                hash ^= static_cast<unsigned char>(str[i]);
+                hash *= 1099511628211u;
+            }
+            return hash;
+        }
+
+        void start_session() {
+            strings.clear();
+            string_indices_by_hash.clear();
+            last_command_ns = now_ns();
+            session_id = last_command_ns ^ (static_cast<std::uint64_t>(getpid()) << 32) ^ reinterpret_cast<std::uintptr_t>(this);
+            payload.push_back(CLIMAP_LOG_SESSION_START);
+            put_fixed(last_command_ns, 8);
+        }
+
+        std::uint32_t string_index(const char * str) {
+            std::size_t length = std::strlen(str);
+            std::vector<std::uint32_t>& candidates = string_indices_by_hash[hash_of(str, length)];
+            for (std::uint32_t index: candidates) {
+                if (strings[index].size() == length && std::memcmp(strings[index].data(), str, length) == 0) return index;
+            }
+            std::uint32_t index = static_cast<std::uint32_t>(strings.size());
+            strings.emplace_back(str, length);
+            candidates.push_back(index);
+            payload.push_back(CLIMAP_LOG_STRING);
+            put_varint(length);
+            payload.insert(payload.end(), str, str + length);
+            return index;
+        }
+
+        void put_varint(std::uint64_t value) {
+            while (value >= 0x80) {
+                payload.push_back(static_cast<unsigned char>(value | 0x80));
+                value >>= 7;
+            }
+            payload.push_back(static_cast<unsigned char>(value));
+        }
+
+        void put_fixed(std::uint64_t value, int bytes) {
+            for (int i = 0; i != bytes; ++i) payload.push_back(static_cast<unsigned char>(value >> (8*i)));
+        }
+
+        void flush_locked() {
+            if (commands_pending == 0) return;
+            commands_pending = 0;
+            std::vector<unsigned char> block;
+            block.reserve(16 + payload.size());
+            std::swap(block, payload);
+            put_fixed(CLIMAP_LOG_BLOCK_MAGIC, 4);
+            put_fixed(block.size(), 4);
+            put_fixed(session_id, 8);
+            payload.insert(payload.end(), block.begin(), block.end());
+            // A single write, so that blocks from concurrent processes do not interleave.
+            const unsigned char * data = payload.data();
+            std::size_t left = payload.size();
+            while (left != 0) {
+                ssize_t written = write(fd, data, left);
+                if (written <= 0) break;    // Recording is best effort, and never fails the command.
+                data += written;
+                left -= static_cast<std::size_t>(written);
+            }
+            payload.clear();
+        }
+};
+
+inline bool climap_record_from_environment() {
+    // Installs a recorder appending to the log named by CLIMAP_RECORD, if set. The recorder flushes
+    // when it is destroyed at exit.
+    static const char * path = std::getenv("CLIMAP_RECORD");
+    if (path == nullptr || *path == '\0') return false;
+    try {
+        static CLIMapLogRecorder recorder(path);
+        return CLIMapRecorder::install(&recorder);
+    } catch (const std::runtime_error&) {
+        return false;   // Recording is best effort, and never stops the program.
+    }
+}
+
+namespace {
+    const bool climap_log_recorder_installed = climap_record_from_environment();
+}
+
+class CLIMapReplayLog {
+    public:
+        struct Command {
+            std::uint64_t time_ns;  // Since the epoch.
+            int args_to_skip;
+            std::vector<char *> argv;
+        };
+
+        explicit CLIMapReplayLog(const char * path) {
+            std::ifstream file(path, std::ios::binary);
+            if (!file) throw std::runtime_error(std::string("CLIMapReplayLog could not open \"") + path + "\".");
+            std::vector<unsigned char> log((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+            std::unordered_map<std::uint64_t, Session> sessions;
+            std::size_t pos = 0;
+            while (pos + 16 <= log.size()) {
+                if (get_fixed(log, pos, 4) != CLIMAP_LOG_BLOCK_MAGIC) throw std::runtime_error("CLIMapReplayLog: corrupt block header.");
+                std::size_t end = pos + 16 + get_fixed(log, pos + 4, 4);
+                Session& session = sessions[get_fixed(log, pos + 8, 8)];
+                pos += 16;
+                if (end > log.size()) throw std::runtime_error("CLIMapReplayLog: truncated block.");
+                while (pos < end) read_record(log, pos, session);
+            }
+            std::stable_sort(commands.begin(), commands.end(), [](const Command& a, const Command& b) { return a.time_ns < b.time_ns; });
+        }
+
+        const std::vector<Command>& get_commands() const {
+            return commands;
+        }
+
+    private:
+        struct Session {
+            std::uint64_t last_command_ns = 0;
+            std::vector<char *> strings;
+        };
+
+        std::deque<std::string> string_storage;     // std::deque never relocates elements, so argv may point into it.
+        std::vector<Command> commands;
+
+        static std::uint64_t get_fixed(const std::vector<unsigned char>& log, std::size_t pos, int bytes) {
+            std::uint64_t value = 0;
+            for (int i = 0; i != bytes; ++i) value |= static_cast<std::uint64_t>(log.at(pos + i)) << (8*i);
+            return value;
+        }
+
+        static std::uint64_t get_varint(const std::vector<unsigned char>& log, std::size_t& pos) {
+            std::uint64_t value = 0;
+            for (int shift = 0; shift < 64; shift += 7) {
+                unsigned char byte = log.at(pos++);
+                value |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+                if ((byte & 0x80) == 0) return value;
+            }
+            throw std::runtime_error("CLIMapReplayLog: corrupt varint.");
+        }
+
+        void read_record(const std::vector<unsigned char>& log, std::size_t& pos, Session& session) {
+            unsigned char type = log.at(pos++);
+            if (type == CLIMAP_LOG_SESSION_START) {
+                session.last_command_ns = get_fixed(log, pos, 8);
+                session.strings.clear();
+                pos += 8;
+            } else if (type == CLIMAP_LOG_STRING) {
+                std::size_t length = get_varint(log, pos);
+                if (pos + length > log.size()) throw std::runtime_error("CLIMapReplayLog: truncated string.");
+                string_storage.emplace_back(reinterpret_cast<const char *>(log.data() + pos), length);
+                session.strings.push_back(&string_storage.back()[0]);
+                pos += length;
+            } else if (type == CLIMAP_LOG_COMMAND) {
+                Command command;
+                session.last_command_ns += get_varint(log, pos);
+                command.time_ns = session.last_command_ns;
+                command.args_to_skip = static_cast<int>(get_varint(log, pos));
+                std::size_t argc = get_varint(log, pos);
+                for (std::size_t i = 0; i != argc; ++i) command.argv.push_back(session.strings.at(get_varint(log, pos)));
+                command.argv.push_back(nullptr);    // As argv[argc] is for main.
+                commands.push_back(std::move(command));
+            } else {
+                throw std::runtime_error("CLIMapReplayLog: unknown record type.");
+            }
+        }
+};
+
+class CLIMapReplayReport {
+    // Per-command latencies in power of two nanosecond buckets.
+    public:
+        static constexpr int bucket_count = 64;
+
+        void add(std::uint64_t latency_ns) {
+            int bucket = 0;
+            while (bucket != bucket_count - 1 && (latency_ns >> (bucket + 1)) != 0) ++bucket;
+            ++buckets[bucket];
+            ++commands;
+            total_latency_ns += latency_ns;
+        }
+
+        std::uint64_t percentile_upper_bound_ns(double percentile) const {
+            std::uint64_t rank = static_cast<std::uint64_t>(percentile / 100 * commands);
+            std::uint64_t seen = 0;
+            for (int bucket = 0; bucket != bucket_count; ++bucket) {
+                seen += buckets[bucket];
+                if (seen > rank) return std::uint64_t(2) << bucket;
+            }
+            return 0;
+        }
+
+        void print(std::ostream& out) const {
+            double elapsed_s = elapsed_ns / 1e9;
+            out << commands << " commands in " << elapsed_s << " s (" << (elapsed_s > 0 ? commands / elapsed_s : 0) << " commands/s), "
+                << "mean latency " << (commands != 0 ? total_latency_ns / commands : 0) << " ns\n"
+                << "p50 < " << percentile_upper_bound_ns(50) << " ns, p90 < " << percentile_upper_bound_ns(90)
+                << " ns, p99 < " << percentile_upper_bound_ns(99) << " ns\n"
+                << "latency (ns)          commands\n";
+            for (int bucket = 0; bucket != bucket_count; ++bucket) {
+                if (buckets[bucket] == 0) continue;
+                out << "< " << std::left << std::setw(18) << (std::uint64_t(2) << bucket) << std::right << ' ' << buckets[bucket] << '\n';
+            }
+        }
+
+        std::uint64_t commands = 0;
+        std::uint64_t total_latency_ns = 0;
+        std::uint64_t elapsed_ns = 0;
+        std::uint64_t buckets[bucket_count] = {};
+};
+
+template<typename ExecFn>
+CLIMapReplayReport climap_replay(const CLIMapReplayLog& log, ExecFn exec, double speed = 0) {
+    // Calls exec(argc, argv, args_to_skip) for every command in log, e.g. with a lambda calling the
+    // program's top level exec_main. With speed 0 commands run back to back, otherwise each waits
+    // until its recorded offset from the first command, divided by speed.
+    using Clock = std::chrono::steady_clock;
+    CLIMapReplayReport report;
+    const auto& commands = log.get_commands();
+    const Clock::time_point start = Clock::now();
+    for (const auto& command: commands) {
+        if (speed > 0) {
+            auto offset = std::chrono::nanoseconds(static_cast<std::int64_t>((command.time_ns - commands.front().time_ns) / speed));
+            std::this_thread::sleep_until(start + offset);
+        }
+        std::vector<char *> argv = command.argv;    // exec may permute argv, so every replay gets a copy.
+        const Clock::time_point before = Clock::now();
+        exec(static_cast<int>(argv.size() - 1), argv.data(), command.args_to_skip);
+        report.add(static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - before).count()));
+    }
+    report.elapsed_ns = static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count());
+    return report;
+}
+
+#endif
@@ -0,0 +1,382 @@
+#ifndef CLIMAP_RESULT_CACHE_HEADER_GUARD
+#define CLIMAP_RESULT_CACHE_HEADER_GUARD
+
+// Optional persistent cache of pure handlers' output, shared by every process that maps the same
+// file. Including this header installs a CLIMapMappedResultCache if the CLIMAP_RESULT_CACHE
+// environment variable names a cache file, which is created if need be. Handlers are cached once
+// marked climap_pure, which this header defines:
+//
+//      static const CLIMap<> climap {
+//          {"fact", climap_pure(fact_main)},
+//          ...
+//      };
+//
+// See CLIMapResultCache for how calls are keyed. Entries are keyed by the maps' keys, not by what
+// their handlers do, so a cache file must be deleted when a pure handler's output changes.
+//
+// The file is a header followed by a fixed number of fixed size slots, so its size never changes
+// once created, and an entry is found by probing the few slots after its hash, in one page. Each
+// slot is guarded by a sequence number, odd while the slot is written: readers copy the entry and
+// check that the sequence did not change meanwhile, and writers claim a slot by compare and swap,
+// so that neither ever waits. When the probed slots are full, the least recently used is evicted.
+// Output longer than a slot holds is not cached. A writer that dies mid-write leaves its slot
+// unused, rather than corrupt, and a process that dies while creating the file leaves a header of
+// zeros, which the next process to open it takes as no cache yet. The slot count and size are read
+// from the header once, when the file is opened and checked, so that a file changed after cannot
+// make a probe stray outside the mapping.
+//
+//      header: CLIMAP_RESULT_CACHE_MAGIC, CLIMAP_RESULT_CACHE_VERSION, slot count, slot size (uint32
+//              each), clock (uint64), padded to CLIMAP_RESULT_CACHE_HEADER_SIZE bytes
+//      slot:   sequence, last used clock, key hash, key check (uint64 each), output size (uint32),
+//              padding (uint32), output bytes
+//
+// Integers are native endian, so a cache file belongs to one machine.
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "CLIMap.hpp"
+
+class CLIMapResultCache {
+    // Memoises the output of handlers marked climap_pure, across runs and processes; see
+    // CLIMapMappedResultCache for a memory mapped table. While a cache is installed, a pure handler's
+    // call is keyed by its map's raw arg keys, the key it matched, the output format, and its
+    // arguments up to the next one matching a raw arg key of the same map, where it is predicted to
+    // finish as for CLIMapWorkers (see CLIMapParallel.hpp). A hit writes the stored output to
+    // climap_cout() instead of calling the handler. A miss calls it with its output captured, writes
+    // the output, and stores it if the handler finished as predicted. Only maps of C string arguments
+    // are cached.
+    public:
+        struct Key {
+            std::uint64_t hash = 14695981039346656037u;     // FNV-1a, which places the entry.
+            std::uint64_t check = 0;                        // An independent hash, which confirms it.
+
+            void add(std::uint64_t value) {
+                for (int i = 0; i != 8; ++i) add_byte(static_cast<unsigned char>(value >> (8*i)));
+            }
+
+            void add(const char * arg) {
+                // Length first, so that ("ab", "c") and ("a", "bc") differ.
+                const std::size_t length = std::strlen(arg);
+                add(static_cast<std::uint64_t>(length));
+                for (std::size_t i = 0; i != length; ++i) add_byte(static_cast<unsigned char>(arg[i]));
+            }
+
+            void add_byte(unsigned char byte) {
+                hash = (hash ^ byte) * 1099511628211u;
+                check = (check + byte + 1) * 0x9e3779b97f4a7c15u;
+                check ^= check >> 29;
+            }
+        };
+
+        virtual ~CLIMapResultCache() { }
+
+        virtual bool find(const Key& key, std::string& output) = 0;
+        virtual void insert(const Key& key, const std::string& output) = 0;     // Best effort.
+
+        static bool install(CLIMapResultCache * cache) {
+            active_slot().store(cache, std::memory_order_release);
+            return true;
+        }
+
+        static CLIMapResultCache * active() {
+            return active_slot().load(std::memory_order_acquire);
+        }
+
+    private:
+        static std::atomic<CLIMapResultCache *>& active_slot() {
+            static std::atomic<CLIMapResultCache *> active_cache{nullptr};
+            return active_cache;
+        }
+};
+
+template<typename Marks>
+struct CLIMapPure : Marks {     // climap_pure's, which calls the handler through CachedCall.
+    template<typename Map>
+    static constexpr auto call_hook() -> decltype(&Map::CachedCall::call) {
+        return &Map::CachedCall::call;
+    }
+};
+
+template<typename ArgIterator, typename Marks>
+constexpr CLIMapMarkedHandler<ArgIterator, CLIMapPure<Marks>> climap_pure(CLIMapMarkedHandler<ArgIterator, Marks> marked) {
+    return CLIMapMarkedHandler<ArgIterator, CLIMapPure<Marks>>{marked.function};
+}
+
+template<typename ArgIterator>
+constexpr CLIMapMarkedHandler<ArgIterator, CLIMapPure<CLIMapUnmarked>> climap_pure(int (*function)(int, ArgIterator)) {
+    // Marks a handler whose output depends only on its arguments, e.g. {"fact", climap_pure(fact_main)},
+    // so that its output may be cached and written instead of calling it; see CLIMapResultCache. A
+    // pure handler is still called sequentially, unless also speculative: climap_pure(climap_speculative(fact_main)).
+    return CLIMapMarkedHandler<ArgIterator, CLIMapPure<CLIMapUnmarked>>{function};
+}
+
+template<typename ArgType, typename MatchFnType, typename ArgIterator>
+class CLIMap<ArgType, MatchFnType, ArgIterator>::CachedCall {
+    // call for pure handlers, through the installed cache, if any.
+    public:
+        static int call(const CLIMap& climap, const Handler& handler, const DispatchState& state, bool) {
+            CLIMapResultCache * const cache = CLIMapResultCache::active();
+            if (cache == nullptr) return handler.function(state.argc_callee, state.argv_callee);
+            return call_cached(climap, *cache, handler, state, std::is_same<ArgType, const char *>());
+        }
+
+    private:
+        static int call_cached(const CLIMap&, CLIMapResultCache&, const Handler& handler, const DispatchState& state, std::false_type) {
+            return handler.function(state.argc_callee, state.argv_callee);
+        }
+
+        static int call_cached(const CLIMap& climap, CLIMapResultCache& cache, const Handler& handler, const DispatchState& state, std::true_type) {
+            // A pure handler's call through cache; see CLIMapResultCache.
+            CLIMapResultCache::Key key;
+            key.add(climap.key_table.signature());
+            key.add(static_cast<std::uint64_t>(state.match_index));
+            key.add(static_cast<std::uint64_t>(CLIMapOutputWriter::format()));
+            ArgIterator arg = state.argv_callee;
+            key.add(*arg);
+            int predicted_args = 1;
+            while (predicted_args < state.argc_callee) {
+                std::advance(arg, 1);
+                if (is_end_of_args(*arg) || climap.key_table.matches_raw_arg(*arg)) break;
+                key.add(*arg);
+                ++predicted_args;
+            }
+            const int predicted_argc_left = state.argc_callee - predicted_args;
+
+            std::string output;
+            if (cache.find(key, output)) {
+                climap_cout() << output;
+                return predicted_argc_left;
+            }
+            std::ostringstream captured_output;
+            std::ostream *& captured = climap_captured_output();
+            std::ostream * const outer_captured = captured;
+            captured = &captured_output;
+            int argc_left_or_error;
+            try {
+                argc_left_or_error = handler.function(state.argc_callee, state.argv_callee);
+            } catch (...) {
+                captured = outer_captured;
+                throw;
+            }
+            captured = outer_captured;
+            output = captured_output.str();
+            climap_cout() << output;
+            if (argc_left_or_error == predicted_argc_left) cache.insert(key, output);
+            return argc_left_or_error;
+        }
+};
+
+constexpr std::uint32_t CLIMAP_RESULT_CACHE_MAGIC = 0x43524c43;     // "CLRC"
+constexpr std::uint32_t CLIMAP_RESULT_CACHE_VERSION = 1;
+constexpr std::size_t CLIMAP_RESULT_CACHE_HEADER_SIZE = 64;
+
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2 && ATOMIC_INT_LOCK_FREE == 2, "CLIMapMappedResultCache shares atomics between processes, so needs them lock free.");
+
+class CLIMapMappedResultCache : public CLIMapResultCache {
+    public:
+        // slot_count and slot_size apply when path is created; an existing cache keeps its own.
+        // slot_size, a multiple of 8, bounds the output cached per entry.
+        explicit CLIMapMappedResultCache(const char * path, std::uint32_t slot_count_in = 16384, std::uint32_t slot_size_in = 256) {
+            const int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+            if (fd == -1) throw std::runtime_error(std::string("CLIMapMappedResultCache could not open \"") + path + "\".");
+            try {
+                map_file(fd, path, slot_count_in, slot_size_in);
+            } catch (...) {
+                close(fd);
+                throw;
+            }
+            close(fd);  // The mapping outlives it.
+        }
+
+        CLIMapMappedResultCache(const CLIMapMappedResultCache&) = delete;
+        CLIMapMappedResultCache& operator=(const CLIMapMappedResultCache&) = delete;
+
+        ~CLIMapMappedResultCache() {
+            if (active() == this) install(nullptr);
+            munmap(mapping, mapping_size);
+        }
+
+        bool find(const Key& key, std::string& output) override {
+            for (std::uint32_t probe = 0; probe != probes(); ++probe) {
+                Slot& slot = slot_at(key.hash, probe);
+                const std::uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+                if (sequence == 0) return false;    // Slots fill in probe order, and are never emptied.
+                if (sequence % 2 != 0 || !slot.holds(key)) continue;
+                const std::uint32_t size = slot.size.load(std::memory_order_relaxed);
+                if (size > max_output_size()) continue;
+                output.assign(slot.output(), size);
+                // A release read-modify-write, rather than a fence, keeps the copy before the check.
+                if (slot.sequence.fetch_add(0, std::memory_order_release) != sequence) continue;   // Overwritten while copied.
+                slot.last_used.store(tick(), std::memory_order_relaxed);
+                return true;
+            }
+            return false;
+        }
+
+        void insert(const Key& key, const std::string& output) override {
+            if (output.size() > max_output_size()) return;
+            Slot * victim = nullptr;
+            std::uint64_t victim_sequence = 0;
+            std::uint64_t victim_last_used = 0;
+            for (std::uint32_t probe = 0; probe != probes(); ++probe) {
+                Slot& slot = slot_at(key.hash, probe);
+                const std::uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+                if (sequence % 2 != 0) continue;    // Being written.
+                const std::uint64_t last_used = slot.last_used.load(std::memory_order_relaxed);
+                if (sequence == 0 || slot.holds(key)) {
+                    victim = &slot;
+                    victim_sequence = sequence;
+                    break;
+                }
+                if (victim == nullptr || last_used < victim_last_used) {
+                    victim = &slot;
+                    victim_sequence = sequence;
+                    victim_last_used = last_used;
+                }
+            }
+            // Claims the slot, unless another writer got there first, whose entry then stands. Acquiring
+            // the claim keeps the writes below after it.
+            if (victim == nullptr || !victim->sequence.compare_exchange_strong(victim_sequence, victim_sequence + 1, std::memory_order_acquire)) return;
+            victim->hash.store(key.hash, std::memory_order_relaxed);
+            victim->check.store(key.check, std::memory_order_relaxed);
+            victim->size.store(static_cast<std::uint32_t>(output.size()), std::memory_order_relaxed);
+            std::memcpy(victim->output(), output.data(), output.size());
+            victim->last_used.store(tick(), std::memory_order_relaxed);
+            victim->sequence.store(victim_sequence + 2, std::memory_order_release);
+        }
+
+        std::uint32_t slot_count() const {
+            return slot_total;
+        }
+
+        std::size_t max_output_size() const {
+            return slot_stride - sizeof(Slot);
+        }
+
+    private:
+        struct Header {
+            std::uint32_t magic;
+            std::uint32_t version;
+            std::uint32_t slot_count;
+            std::uint32_t slot_size;
+            std::atomic<std::uint64_t> clock;   // Ticks on every hit and insert, for last_used.
+        };
+
+        struct Slot {
+            std::atomic<std::uint64_t> sequence;    // 0 while never written, odd while being written.
+            std::atomic<std::uint64_t> last_used;
+            std::atomic<std::uint64_t> hash;
+            std::atomic<std::uint64_t> check;
+            std::atomic<std::uint32_t> size;
+            std::uint32_t padding;
+
+            bool holds(const Key& key) const {
+                return hash.load(std::memory_order_relaxed) == key.hash && check.load(std::memory_order_relaxed) == key.check;
+            }
+
+            char * output() {
+                return reinterpret_cast<char *>(this + 1);
+            }
+        };
+
+        static_assert(sizeof(Header) <= CLIMAP_RESULT_CACHE_HEADER_SIZE, "CLIMapMappedResultCache header overflows.");
+        static_assert(sizeof(Slot) == 40, "CLIMapMappedResultCache slots are laid out as documented.");
+
+        static constexpr std::uint32_t max_probes = 8;
+
+        void * mapping = nullptr;
+        std::size_t mapping_size = 0;
+        Header * header = nullptr;      // Only its clock is used once mapped.
+        char * slots = nullptr;
+        std::uint32_t slot_total = 0;   // As checked when mapped.
+        std::uint32_t slot_stride = 0;
+
+        void map_file(int fd, const char * path, std::uint32_t slot_count_in, std::uint32_t slot_size_in) {
+            // Under an exclusive lock, so that a cache being created is never seen half initialised.
+            if (flock(fd, LOCK_EX) == -1) throw std::runtime_error(std::string("CLIMapMappedResultCache could not lock \"") + path + "\".");
+            struct stat file_stat;
+            if (fstat(fd, &file_stat) == -1) throw std::runtime_error(std::string("CLIMapMappedResultCache could not stat \"") + path + "\".");
+            // Fields past the end of a short file stay zero.
+            Header file_header{};
+            if (pread(fd, &file_header, sizeof(std::uint32_t)*4, 0) == -1) throw std::runtime_error(std::string("CLIMapMappedResultCache could not read \"") + path + "\".");
+            // Empty, or left by a process that died creating it before writing the header.
+            const bool created = file_header.magic == 0 && file_header.version == 0 && file_header.slot_count == 0 && file_header.slot_size == 0;
+            if (created) {
+                if (slot_count_in == 0 || slot_size_in % 8 != 0 || slot_size_in <= sizeof(Slot)) throw std::invalid_argument("CLIMapMappedResultCache slot count or size invalid.");
+                file_header.slot_count = slot_count_in;
+                file_header.slot_size = slot_size_in;
+                // Truncating first leaves every slot of a file of any size zero, which is empty.
+                if (ftruncate(fd, 0) == -1 || ftruncate(fd, static_cast<off_t>(file_size(file_header))) == -1) throw std::runtime_error(std::string("CLIMapMappedResultCache could not size \"") + path + "\".");
+            } else if (file_header.magic != CLIMAP_RESULT_CACHE_MAGIC || file_header.version != CLIMAP_RESULT_CACHE_VERSION
+                    || file_header.slot_count == 0 || file_header.slot_size % 8 != 0 || file_header.slot_size <= sizeof(Slot)
+                    || static_cast<std::uint64_t>(file_stat.st_size) != file_size(file_header)) {
+                throw std::runtime_error(std::string("\"") + path + "\" is not a CLIMapMappedResultCache file.");
+            }
+            slot_total = file_header.slot_count;
+            slot_stride = file_header.slot_size;
+
+            mapping_size = file_size(file_header);
+            mapping = mmap(nullptr, mapping_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            if (mapping == MAP_FAILED) throw std::runtime_error(std::string("CLIMapMappedResultCache could not map \"") + path + "\".");
+            header = static_cast<Header *>(mapping);
+            slots = static_cast<char *>(mapping) + CLIMAP_RESULT_CACHE_HEADER_SIZE;
+            if (created) {
+                // A new file reads as zeros, which is every slot empty and the clock at 0. The magic goes
+                // last, so that the header is whole once it is there.
+                header->slot_count = slot_total;
+                header->slot_size = slot_stride;
+                header->version = CLIMAP_RESULT_CACHE_VERSION;
+                header->magic = CLIMAP_RESULT_CACHE_MAGIC;
+            }
+            flock(fd, LOCK_UN);
+        }
+
+        static std::uint64_t file_size(const Header& file_header) {
+            return CLIMAP_RESULT_CACHE_HEADER_SIZE + static_cast<std::uint64_t>(file_header.slot_count)*file_header.slot_size;
+        }
+
+        std::uint32_t probes() const {
+            return slot_total < max_probes ? slot_total : max_probes;
+        }
+
+        Slot& slot_at(std::uint64_t hash, std::uint32_t probe) const {
+            const std::uint64_t index = (hash + probe) % slot_total;
+            return *reinterpret_cast<Slot *>(slots + index*slot_stride);
+        }
+
+        std::uint64_t tick() const {
+            return header->clock.fetch_add(1, std::memory_order_relaxed) + 1;
+        }
+};
+
+inline bool climap_result_cache_from_environment() {
+    // Installs a cache mapping the file named by CLIMAP_RESULT_CACHE, if set.
+    static const char * path = std::getenv("CLIMAP_RESULT_CACHE");
+    if (path == nullptr || *path == '\0') return false;
+    try {
+        static CLIMapMappedResultCache cache(path);
+        return CLIMapResultCache::install(&cache);
+    } catch (const std::exception&) {
+        return false;   // Caching is best effort, and never stops the program.
+    }
+}
+
+namespace {
+    const bool climap_mapped_result_cache_installed = climap_result_cache_from_environment();
+}
+
+#endif
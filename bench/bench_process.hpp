@@ -0,0 +1,44 @@
+#ifndef CLIMAP_BENCH_PROCESS_HEADER_GUARD
+#define CLIMAP_BENCH_PROCESS_HEADER_GUARD
+
+// Runs a child process for the benchmarks, measuring its wall time and peak memory.
+
+#include <cerrno>
+#include <string>
+#include <vector>
+
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+struct ProcessUsage {
+    double seconds = 0;
+    long peak_rss_kb = 0;
+    bool ok = true;    // Exited with status 0.
+};
+
+inline ProcessUsage run_process(const std::vector<std::string>& args) {
+    ProcessUsage usage;
+    timeval start, end;
+    gettimeofday(&start, nullptr);
+    pid_t pid = fork();
+    if (pid == 0) {
+        std::vector<char *> argv;
+        for (const auto& arg: args) argv.push_back(const_cast<char *>(arg.c_str()));
+        argv.push_back(nullptr);
+        execvp(argv[0], argv.data());
+        _exit(127);
+    }
+    int status = 0;
+    rusage child_usage;
+    while (wait4(pid, &status, 0, &child_usage) == -1 && errno == EINTR) { }
+    gettimeofday(&end, nullptr);
+
+    usage.ok = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    usage.seconds = (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec) / 1e6;
+    usage.peak_rss_kb = child_usage.ru_maxrss;
+    return usage;
+}
+
+#endif
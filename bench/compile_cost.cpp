@@ -0,0 +1,180 @@
+// Measures what CLIMap costs to compile. For every combination of total keys and tree depth, writes
+// a synthetic command tree of nested CLIMaps split over several translation units, compiles each,
+// and reports the summed compile time, the peak compiler memory and the summed object size. Every
+// tree is written and compiled twice: with each map built from an initializer list, and from a
+// static constexpr array of CLIMap<>::RawPairType.
+//
+//      climap_compile_cost <compiler> <climap dir> <work dir> [std [keys,... [depths,...]]]
+//
+// e.g. climap_compile_cost g++ .. /tmp/climap_compile_cost c++11 10,100,1000,10000 1,2,5,10
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <sys/stat.h>
+
+#include "bench_process.hpp"
+
+using std::cerr;
+using std::cout;
+using std::endl;
+using std::ofstream;
+using std::string;
+using std::to_string;
+using std::vector;
+
+namespace {
+
+constexpr int maps_per_file = 25;
+
+struct Compilation {
+    double seconds = 0;
+    long peak_rss_kb = 0;
+    long long object_bytes = 0;
+    bool ok = true;
+};
+
+vector<int> parse_list(const string& list) {
+    vector<int> values;
+    std::stringstream ss(list);
+    string value;
+    while (std::getline(ss, value, ',')) values.push_back(std::stoi(value));
+    return values;
+}
+
+int fanout_for(int keys, int depth) {
+    // The smallest fanout whose full tree of the given depth has at least keys keys.
+    for (int fanout = 1; ; ++fanout) {
+        long long total = 0, level = 1;
+        for (int d = 0; d != depth && total < keys; ++d) {
+            level *= fanout;
+            total += level;
+        }
+        if (total >= keys) return fanout;
+    }
+}
+
+vector<string> write_tree(const string& dir, int keys, int depth, bool constexpr_array) {
+    // Map i is the function map_i, and its children are numbered breadth first. Leaf keys call
+    // leaf_handler, and every map also has a matching function, noarg and anyarg key.
+    const int fanout = fanout_for(keys, depth);
+    vector<int> map_depths{1};
+    vector<vector<int>> children(1);
+    int keys_written = 0;
+    for (std::size_t map = 0; map != map_depths.size(); ++map) {
+        for (int key = 0; key != fanout && keys_written != keys; ++key, ++keys_written) {
+            if (map_depths[map] < depth) {
+                children[map].push_back(static_cast<int>(map_depths.size()));
+                map_depths.push_back(map_depths[map] + 1);
+                children.emplace_back();
+            } else {
+                children[map].push_back(-1);
+            }
+        }
+    }
+
+    ofstream header(dir + "/tree.hpp");
+    header << "#include \"CLIMap.hpp\"\n"
+              "int leaf_handler(int, char**);\n"
+              "bool is_generated_integer(const char *);\n";
+    for (std::size_t map = 0; map != map_depths.size(); ++map) header << "int map_" << map << "(int, char**);\n";
+
+    vector<string> files;
+    for (std::size_t first = 0; first < map_depths.size(); first += maps_per_file) {
+        string file = dir + "/tree_" + to_string(files.size()) + ".cpp";
+        ofstream out(file);
+        out << "#include \"tree.hpp\"\n";
+        if (first == 0) {
+            out << "#include <cstdlib>\n"
+                   "int leaf_handler(int argc, char**) { return argmap_return_success(argc); }\n"
+                   "bool is_generated_integer(const char * arg) { char * end; std::strtol(arg, &end, 10); return *end == '\\0'; }\n";
+        }
+        for (std::size_t map = first; map != map_depths.size() && map != first + maps_per_file; ++map) {
+            out << "int map_" << map << "(int argc, char **argv) {\n";
+            if (constexpr_array) {
+                out << "    static constexpr CLIMap<>::RawPairType climap_keys[] {\n";
+            } else {
+                out << "    static const CLIMap<> climap {\n";
+            }
+            for (std::size_t key = 0; key != children[map].size(); ++key) {
+                out << "        {\"key_" << map << '_' << key << "\", ";
+                if (children[map][key] == -1) {
+                    out << "leaf_handler},\n";
+                } else {
+                    out << "map_" << children[map][key] << "},\n";
+                }
+            }
+            out << "        {is_generated_integer, leaf_handler},\n"
+                   "        {noarg, leaf_handler},\n"
+                   "        {anyarg, leaf_handler}\n"
+                   "    };\n";
+            if (constexpr_array) out << "    static const CLIMap<> climap(climap_keys);\n";
+            out << "    return " << (map == 0 ? "climap.exec_main(argc, argv)" : "climap.exec(argc, argv)") << ";\n"
+                   "}\n";
+        }
+        files.push_back(file);
+    }
+    return files;
+}
+
+Compilation compile(const vector<string>& args, const string& object) {
+    Compilation compilation;
+    const ProcessUsage usage = run_process(args);
+    compilation.ok = usage.ok;
+    compilation.seconds = usage.seconds;
+    compilation.peak_rss_kb = usage.peak_rss_kb;
+    struct stat object_stat;
+    if (stat(object.c_str(), &object_stat) == 0) compilation.object_bytes = object_stat.st_size;
+    return compilation;
+}
+
+void add(Compilation& total, const Compilation& part) {
+    total.seconds += part.seconds;
+    total.peak_rss_kb = std::max(total.peak_rss_kb, part.peak_rss_kb);
+    total.object_bytes += part.object_bytes;
+    total.ok = total.ok && part.ok;
+}
+
+}
+
+int main(int argc, char **argv) {
+    if (argc < 4 || argc > 7) {
+        cerr << "Usage: " << argv[0] << " <compiler> <climap dir> <work dir> [std [keys,... [depths,...]]]" << endl;
+        return EXIT_FAILURE;
+    }
+    const string compiler = argv[1], climap_dir = argv[2], work_dir = argv[3];
+    const string std_flag = "-std=" + string(argc > 4 ? argv[4] : "c++11");
+    const vector<int> key_counts = parse_list(argc > 5 ? argv[5] : "10,100,1000,10000");
+    const vector<int> depths = parse_list(argc > 6 ? argv[6] : "1,2,5,10");
+    mkdir(work_dir.c_str(), 0755);
+
+    cout << std::setw(8) << "keys" << std::setw(8) << "depth" << std::setw(8) << "TUs" << std::setw(18) << "construction"
+         << std::setw(12) << "seconds" << std::setw(14) << "peak RSS KiB" << std::setw(14) << "object bytes" << endl;
+    for (int keys: key_counts) {
+        for (int depth: depths) {
+            for (bool constexpr_array: {false, true}) {
+                const string dir = work_dir + "/k" + to_string(keys) + "_d" + to_string(depth) + (constexpr_array ? "_array" : "_list");
+                mkdir(dir.c_str(), 0755);
+                const vector<string> files = write_tree(dir, keys, depth, constexpr_array);
+                Compilation total;
+                for (const auto& source: files) {
+                    const string object = source + ".o";
+                    add(total, compile({compiler, std_flag, "-O2", "-I" + climap_dir, "-I" + dir, "-c", source, "-o", object}, object));
+                }
+                cout << std::setw(8) << keys << std::setw(8) << depth << std::setw(8) << files.size()
+                     << std::setw(18) << (constexpr_array ? "constexpr array" : "initializer list")
+                     << std::setw(12) << std::fixed << std::setprecision(2) << total.seconds
+                     << std::setw(14) << total.peak_rss_kb << std::setw(14) << total.object_bytes
+                     << (total.ok ? "" : "  (compilation failed)") << endl;
+            }
+        }
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,137 @@
+// Measures CLIMapKeyStats key ordering on a skewed workload. Builds a map of many raw arg keys, and
+// dispatches a command line of keys drawn from a Zipf distribution whose most frequent keys are
+// declared last, the worst case for declaration order. Reports the mean time per lookup with the
+// keys in declaration order, while counting hits, ordered by a profile of a training run, and in
+// adaptive mode.
+//
+//      climap_key_order [keys,... [lookups [skew [runs]]]]
+//
+// e.g. climap_key_order 8,64,512 1000000 1.1 5
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "CLIMap.hpp"
+#include "CLIMapKeyStats.hpp"
+
+using std::cerr;
+using std::cout;
+using std::endl;
+using std::string;
+using std::to_string;
+using std::vector;
+
+namespace {
+
+vector<int> parse_list(const string& list) {
+    vector<int> values;
+    std::stringstream ss(list);
+    string value;
+    while (std::getline(ss, value, ',')) values.push_back(std::stoi(value));
+    return values;
+}
+
+int bench_handled = 0;
+
+int count_handled(int argc, char **) {
+    ++bench_handled;
+    return argmap_return_success(argc);
+}
+
+vector<string> make_keys(int key_count) {
+    // Distinct first bytes are not guaranteed, as in real command sets.
+    vector<string> keys;
+    for (int key = 0; key != key_count; ++key) keys.push_back("command_" + to_string(key));
+    return keys;
+}
+
+CLIMap<> make_map(const vector<string>& keys) {
+    CLIMap<>::Builder builder;
+    for (const string& key: keys) builder.add(key, count_handled);
+    return builder.freeze();
+}
+
+vector<char *> make_command_line(const vector<string>& keys, int lookups, double skew) {
+    // The rank r key, drawn with weight 1/(r+1)^skew, is the r-th from last declared.
+    vector<double> weights;
+    for (std::size_t rank = 0; rank != keys.size(); ++rank) weights.push_back(1.0/std::pow(rank + 1.0, skew));
+    std::mt19937 generator(42);
+    std::discrete_distribution<std::size_t> ranks(weights.begin(), weights.end());
+    vector<char *> argv{const_cast<char *>("prog")};
+    for (int lookup = 0; lookup != lookups; ++lookup) argv.push_back(const_cast<char *>(keys[keys.size() - 1 - ranks(generator)].c_str()));
+    return argv;
+}
+
+double nanoseconds_per_lookup(const CLIMap<>& climap, vector<char *>& argv, int runs) {
+    double best = 0;
+    for (int run = 0; run != runs; ++run) {
+        bench_handled = 0;
+        const auto start = std::chrono::steady_clock::now();
+        climap.exec_main(static_cast<int>(argv.size()), argv.data());
+        const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+        if (bench_handled != static_cast<int>(argv.size()) - 1) {
+            cerr << "Dispatch stopped after " << bench_handled << " lookups." << endl;
+            std::exit(EXIT_FAILURE);
+        }
+        const double per_lookup = elapsed.count()/bench_handled;
+        if (run == 0 || per_lookup < best) best = per_lookup;
+    }
+    return best;
+}
+
+}
+
+int main(int argc, char **argv) {
+    if (argc > 5) {
+        cerr << "Usage: " << argv[0] << " [keys,... [lookups [skew [runs]]]]" << endl;
+        return EXIT_FAILURE;
+    }
+    const vector<int> key_counts = parse_list(argc > 1 ? argv[1] : "8,64,512");
+    const int lookups = std::stoi(argc > 2 ? argv[2] : "1000000");
+    const double skew = std::stod(argc > 3 ? argv[3] : "1.1");
+    const int runs = std::stoi(argc > 4 ? argv[4] : "5");
+
+    cout << std::setw(8) << "keys" << std::setw(14) << "declared ns" << std::setw(14) << "counting ns"
+         << std::setw(14) << "profiled ns" << std::setw(14) << "adaptive ns" << endl;
+    for (int key_count: key_counts) {
+        const vector<string> keys = make_keys(key_count);
+        vector<char *> command_line = make_command_line(keys, lookups, skew);
+
+        const CLIMap<> declared = make_map(keys);
+        const double declared_ns = nanoseconds_per_lookup(declared, command_line, runs);
+
+        CLIMapKeyStats::set_mode(CLIMapKeyStats::Mode::count);
+        const CLIMap<> counting = make_map(keys);
+        CLIMapKeyStats::set_mode(CLIMapKeyStats::Mode::off);
+        const double counting_ns = nanoseconds_per_lookup(counting, command_line, runs);
+
+        // Ordered by the counting map's runs, and timed on the command line reversed.
+        std::stringstream profile;
+        CLIMapKeyStats::dump(profile);
+        CLIMapKeyStats::load(profile);
+        const CLIMap<> profiled = make_map(keys);
+        std::stringstream no_profile("climap-key-profile 1\n");
+        CLIMapKeyStats::load(no_profile);
+        vector<char *> other_command_line = make_command_line(keys, lookups, skew);
+        std::reverse(other_command_line.begin() + 1, other_command_line.end());
+        const double profiled_ns = nanoseconds_per_lookup(profiled, other_command_line, runs);
+
+        CLIMapKeyStats::set_mode(CLIMapKeyStats::Mode::adapt);
+        const CLIMap<> adaptive = make_map(keys);
+        CLIMapKeyStats::set_mode(CLIMapKeyStats::Mode::off);
+        const double adaptive_ns = nanoseconds_per_lookup(adaptive, command_line, runs);
+
+        cout << std::setw(8) << key_count << std::fixed << std::setprecision(1)
+             << std::setw(14) << declared_ns << std::setw(14) << counting_ns
+             << std::setw(14) << profiled_ns << std::setw(14) << adaptive_ns << endl;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,154 @@
+// Measures what CLIMapPlugin saves at startup. Writes a command line program of many subcommands,
+// each with the relocations and static initialisation of typical handler code, and builds it twice:
+// fully static, and with every handler in its own shared object loaded by a CLIMapPlugin. Then runs
+// one subcommand of each repeatedly, and reports the mean wall time and the peak RSS per run.
+//
+//      climap_plugin_startup <compiler> <climap dir> <work dir> [std [handlers,... [runs]]]
+//
+// e.g. climap_plugin_startup g++ .. /tmp/climap_plugin_startup c++11 10,100,500 50
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <sys/stat.h>
+
+#include "bench_process.hpp"
+
+using std::cerr;
+using std::cout;
+using std::endl;
+using std::ofstream;
+using std::string;
+using std::to_string;
+using std::vector;
+
+namespace {
+
+constexpr int words_per_handler = 64;
+
+vector<int> parse_list(const string& list) {
+    vector<int> values;
+    std::stringstream ss(list);
+    string value;
+    while (std::getline(ss, value, ',')) values.push_back(std::stoi(value));
+    return values;
+}
+
+void write_handler(const string& file, int handler) {
+    // A table of pointers to relocate, and an index built by a static initialiser.
+    const string name = "handler_" + to_string(handler);
+    ofstream out(file);
+    out << "#include <map>\n"
+           "#include <string>\n"
+           "namespace {\n"
+           "const char * const words[] {\n";
+    for (int word = 0; word != words_per_handler; ++word) out << "    \"" << name << "_word_" << word << "\",\n";
+    out << "};\n"
+           "std::map<std::string, int> make_index() {\n"
+           "    std::map<std::string, int> index;\n"
+           "    for (int word = 0; word != " << words_per_handler << "; ++word) index[words[word]] = word;\n"
+           "    return index;\n"
+           "}\n"
+           "const std::map<std::string, int> index = make_index();\n"
+           "}\n"
+           "extern \"C\" int " << name << "(int argc, char **argv) {\n"
+           "    int parsed = argc > 1 && index.count(argv[1]) != 0 ? 1 : 0;\n"
+           "    return argc - (1+parsed);\n"
+           "}\n";
+}
+
+void write_main(const string& file, const string& dir, int handlers, bool plugins) {
+    ofstream out(file);
+    if (plugins) {
+        out << "#include \"CLIMapPlugin.hpp\"\n"
+               "namespace {\n";
+        for (int handler = 0; handler != handlers; ++handler) {
+            out << "CLIMapPlugin<> plugin_" << handler << "(\"" << dir << "/libhandler_" << handler << ".so\", \"handler_" << handler << "\");\n";
+        }
+        out << "}\n";
+    } else {
+        out << "#include \"CLIMap.hpp\"\n";
+        for (int handler = 0; handler != handlers; ++handler) out << "extern \"C\" int handler_" << handler << "(int, char**);\n";
+    }
+    out << "int main(int argc, char **argv) {\n"
+           "    static constexpr CLIMap<>::RawPairType climap_keys[] {\n";
+    for (int handler = 0; handler != handlers; ++handler) {
+        out << "        {\"cmd_" << handler << "\", ";
+        if (plugins) {
+            out << "CLIMapPlugin<>::handler<plugin_" << handler << ">},\n";
+        } else {
+            out << "handler_" << handler << "},\n";
+        }
+    }
+    out << "    };\n"
+           "    static const CLIMap<> climap(climap_keys);\n"
+           "    return climap.exec_main(argc, argv);\n"
+           "}\n";
+}
+
+bool build(const string& compiler, const string& std_flag, const string& climap_dir, const string& dir, int handlers) {
+    // Builds dir/static_cli and dir/plugin_cli with its shared objects.
+    bool ok = true;
+    vector<string> static_link{compiler, std_flag, "-O2", "-I" + climap_dir, dir + "/main_static.cpp", "-o", dir + "/static_cli"};
+    for (int handler = 0; handler != handlers && ok; ++handler) {
+        const string source = dir + "/handler_" + to_string(handler) + ".cpp";
+        const string object = source + ".o";
+        write_handler(source, handler);
+        ok = run_process({compiler, std_flag, "-O2", "-fPIC", "-c", source, "-o", object}).ok
+            && run_process({compiler, "-shared", object, "-o", dir + "/libhandler_" + to_string(handler) + ".so"}).ok;
+        static_link.push_back(object);
+    }
+    write_main(dir + "/main_static.cpp", dir, handlers, false);
+    write_main(dir + "/main_plugin.cpp", dir, handlers, true);
+    return ok
+        && run_process(static_link).ok
+        && run_process({compiler, std_flag, "-O2", "-I" + climap_dir, dir + "/main_plugin.cpp", "-o", dir + "/plugin_cli", "-ldl"}).ok;
+}
+
+}
+
+int main(int argc, char **argv) {
+    if (argc < 4 || argc > 7) {
+        cerr << "Usage: " << argv[0] << " <compiler> <climap dir> <work dir> [std [handlers,... [runs]]]" << endl;
+        return EXIT_FAILURE;
+    }
+    const string compiler = argv[1], climap_dir = argv[2], work_dir = argv[3];
+    const string std_flag = "-std=" + string(argc > 4 ? argv[4] : "c++11");
+    const vector<int> handler_counts = parse_list(argc > 5 ? argv[5] : "10,100,500");
+    const int runs = std::stoi(argc > 6 ? argv[6] : "50");
+    mkdir(work_dir.c_str(), 0755);
+
+    cout << std::setw(10) << "handlers" << std::setw(10) << "build" << std::setw(12) << "mean ms" << std::setw(14) << "peak RSS KiB" << endl;
+    for (int handlers: handler_counts) {
+        const string dir = work_dir + "/h" + to_string(handlers);
+        mkdir(dir.c_str(), 0755);
+        if (!build(compiler, std_flag, climap_dir, dir, handlers)) {
+            cerr << "Building the " << handlers << " handler programs failed." << endl;
+            return EXIT_FAILURE;
+        }
+
+        for (const string build_name: {"static", "plugin"}) {
+            const int handler = handlers/2;
+            const vector<string> command{dir + "/" + build_name + "_cli", "cmd_" + to_string(handler), "handler_" + to_string(handler) + "_word_0"};
+            double seconds = 0;
+            long peak_rss_kb = 0;
+            bool ok = true;
+            for (int run = 0; run != runs; ++run) {
+                const ProcessUsage usage = run_process(command);
+                seconds += usage.seconds;
+                peak_rss_kb = std::max(peak_rss_kb, usage.peak_rss_kb);
+                ok = ok && usage.ok;
+            }
+            cout << std::setw(10) << handlers << std::setw(10) << build_name
+                 << std::setw(12) << std::fixed << std::setprecision(3) << 1000*seconds/runs
+                 << std::setw(14) << peak_rss_kb << (ok ? "" : "  (run failed)") << endl;
+        }
+    }
+    return EXIT_SUCCESS;
+}
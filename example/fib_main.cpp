@@ -1,25 +1,27 @@
 #include <iostream>
 #include <stdexcept>
 #include <string>
+#include <vector>
 
 #include "CLIMap.hpp"
+#include "CLIMapOutput.hpp"
 #include "integer_tests.hpp"
 #include "whiteboard.hpp"
 
 #include "fib_main.hpp"
 
-using std::cout;
 using std::endl;
 using std::invalid_argument;
 using std::out_of_range;
 using std::stoi;
+using std::vector;
 
 int fib_main(int, char**);
 int fib_f0_main(int, char**);
 int fib_f1_main(int, char**);
 int fib_set_f0_f1(int, char**, int*);
 int fib_out_of_range_main(int, char**);
-int fib_calculate_main(int, char**);
+int fib_calculate_main(int, char**, int);
 int fib_invalid_noarg_main(int, char**);
 int fib_invalid_anyarg_main(int, char**);
 
@@ -27,11 +29,11 @@ int fib_f0 = 0;
 int fib_f1 = 1;
 
 int fib_main(int argc, char **argv) {
-    constexpr CLIMap<> climap {
+    static const CLIMap<> climap {
         {"f0", fib_f0_main},
         {"f1", fib_f1_main},
         {is_out_of_range_integer, fib_out_of_range_main},
-        {is_non_negative_integer, fib_calculate_main},
+        {is_non_negative_integer, climap_bulk(fib_calculate_main)},
         {noarg, fib_invalid_noarg_main},
         {anyarg, fib_invalid_anyarg_main}
     };
@@ -52,7 +54,7 @@ int fib_set_f0_f1(int argc, char **argv, int *f0orf1Ptr) {
     const char * f0orf1_cstring = argv[0];
 
     if (argc==1) {
-        cout << "No argument provided to fib/" << f0orf1_cstring << " command." << endl;
+        if (!CLIMapOutput::error("fib", "no_argument", f0orf1_cstring)) climap_cout() << "No argument provided to fib/" << f0orf1_cstring << " command." << endl;
         return ARGMAP_EXIT_INVALID_ARG;
     }
 
@@ -62,10 +64,10 @@ int fib_set_f0_f1(int argc, char **argv, int *f0orf1Ptr) {
     try {
         arg_int = stoi(arg_cstring);
     } catch (const invalid_argument&) {
-        cout << "fib/" << f0orf1_cstring << " argument \"" << arg_cstring << "\" is not an integer." << endl;
+        if (!CLIMapOutput::error("fib", "not_an_integer", arg_cstring)) climap_cout() << "fib/" << f0orf1_cstring << " argument \"" << arg_cstring << "\" is not an integer." << endl;
         return ARGMAP_EXIT_INVALID_ARG;
     } catch (const out_of_range&) {
-        cout << "fib/" << f0orf1_cstring << " argument \"" << arg_cstring << "\" out of range. Try an integer closer to zero." << endl;
+        if (!CLIMapOutput::error("fib", "out_of_range", arg_cstring)) climap_cout() << "fib/" << f0orf1_cstring << " argument \"" << arg_cstring << "\" out of range. Try an integer closer to zero." << endl;
         return ARGMAP_EXIT_INVALID_ARG;
     }
 
@@ -78,27 +80,33 @@ int fib_set_f0_f1(int argc, char **argv, int *f0orf1Ptr) {
 int fib_out_of_range_main(int argc, char **argv) {
     assert(argc>0);
     const char * arg = argv[0];
-    cout << "Fib argument " << arg << " out of range. Try a non-negative integer closer to zero." << endl;
+    if (!CLIMapOutput::error("fib", "out_of_range", arg)) climap_cout() << "Fib argument " << arg << " out of range. Try a non-negative integer closer to zero." << endl;
     return ARGMAP_EXIT_INVALID_ARG;
 }
 
-int fib_calculate_main(int argc, char **argv) {
-    assert(argc>0);
-    const char * arg_cstring = argv[0];
-    int arg_int = stoi(arg_cstring);
-    cout << fib(arg_int, fib_f0, fib_f1) << endl;
-    return argmap_return_success(argc);
+int fib_calculate_main(int argc, char **argv, int run) {
+    // Takes the run of queries up to the next f0, f1 or other argument, so that the queries for
+    // the same f0 and f1 are answered by one sweep of the series.
+    assert(argc>0 && run>0);
+    vector<int> ns;
+    ns.reserve(run);
+    for (int i = 0; i != run; ++i) ns.push_back(stoi(argv[i]));
+
+    for (int fn: fib(ns, fib_f0, fib_f1)) CLIMapOutput::result("fib", fn);
+    climap_cout().flush();
+
+    return argmap_return_consumed(argc, run);
 }
 
 int fib_invalid_noarg_main(int argc, char **argv) {
     assert(argc>0);
-    cout << "No argument provided to fib command." << endl;
+    if (!CLIMapOutput::error("fib", "no_argument")) climap_cout() << "No argument provided to fib command." << endl;
     return ARGMAP_EXIT_INVALID_ARG;
 }
 
 int fib_invalid_anyarg_main(int argc, char **argv) {
     assert(argc>0);
-    cout << "Fib argument \"" << argv[1] << "\" is invalid - not \"f0\", nor \"f1\", nor a non-negative integer." << endl;
+    if (!CLIMapOutput::error("fib", "invalid_argument", argv[0])) climap_cout() << "Fib argument \"" << argv[0] << "\" is invalid - not \"f0\", nor \"f1\", nor a non-negative integer." << endl;
     return ARGMAP_EXIT_INVALID_ARG;
 }
 
@@ -0,0 +1,27 @@
+// Replays a log recorded by running whiteboard with CLIMAP_RECORD set through the whiteboard
+// CLIMap tree, e.g. whiteboard_replay whiteboard.log 0 >/dev/null for full speed.
+
+#include <cstdlib>
+#include <iostream>
+
+#include "CLIMapRecord.hpp"
+
+#include "whiteboard_main.hpp"
+
+using std::cerr;
+using std::endl;
+
+int main(int argc, char **argv) {
+    if (argc < 2 || argc > 3) {
+        cerr << argv[0] << " <log> [speed]\n"
+                "   speed   0 (the default) replays at full speed, otherwise at speed times the recorded rate.\n";
+        return EXIT_FAILURE;
+    }
+    double speed = argc == 3 ? std::atof(argv[2]) : 0;
+
+    CLIMapReplayLog log(argv[1]);
+    auto exec = [](int argc_replay, char **argv_replay, int) { return whiteboard_main(argc_replay, argv_replay); };
+    CLIMapReplayReport report = climap_replay(log, exec, speed);
+    report.print(cerr);
+    return EXIT_SUCCESS;
+}
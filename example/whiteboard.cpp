@@ -1,11 +1,50 @@
+#include <algorithm>
+#include <cstddef>
+#include <mutex>
 #include <stdexcept>
 #include <string>
+#include <vector>
 
 #include "whiteboard.hpp"
 
 using std::invalid_argument;
+using std::size_t;
 using std::string;
 using std::to_string;
+using std::vector;
+
+namespace {
+    // Fibonacci numbers memoised across calls: the first fib_memo_terms numbers of the series for
+    // each of the fib_memo_seeds most recently used f0, f1 pairs, 64KiB in all.
+    constexpr size_t fib_memo_seeds = 4;
+    constexpr size_t fib_memo_terms = 4096;
+
+    struct FibMemo {
+        int f0;
+        int f1;
+        vector<int> terms;
+    };
+
+    vector<FibMemo> fib_memo;   // Most recently used first.
+    std::mutex fib_memo_mutex;
+
+    int fib_add(int a, int b) {
+        // Wraps on overflow as int addition does in practice, but without the undefined behaviour.
+        return static_cast<int>(static_cast<unsigned>(a) + static_cast<unsigned>(b));
+    }
+
+    vector<int>& fib_memo_terms_for(int f0, int f1) {
+        auto memo = std::find_if(fib_memo.begin(), fib_memo.end(), [=](const FibMemo& m) { return m.f0 == f0 && m.f1 == f1; });
+        if (memo == fib_memo.end()) {
+            if (fib_memo.size() == fib_memo_seeds) fib_memo.pop_back();
+            fib_memo.push_back(FibMemo{f0, f1, vector<int>{f0, f1}});
+            fib_memo.back().terms.reserve(fib_memo_terms);
+            memo = fib_memo.end() - 1;
+        }
+        std::rotate(fib_memo.begin(), memo, memo + 1);
+        return fib_memo.front().terms;
+    }
+}
 
 string fizzbuzz(int n) {
     if (n<1) throw invalid_argument("The fizzbuzz function accepts only positive (>=1) integer input, called with n = " + to_string(n) + ".");
@@ -32,22 +71,53 @@ int fact(int n) {
 
 int fib(int n, int f0, int f1) {
     // Returns the nth fibonacci number.
+    return fib(vector<int>{n}, f0, f1).front();
+}
 
-    if (n<0) throw invalid_argument("fib function accepts only non-negative integer input, called with n = " + to_string(n) + ".");
+vector<int> fib(const vector<int>& ns, int f0, int f1) {
+    // Returns the nth fibonacci number for every n in ns, sweeping the series once up to the largest n.
+
+    int n_max = 0;
+    for (int n: ns) {
+        if (n<0) throw invalid_argument("fib function accepts only non-negative integer input, called with n = " + to_string(n) + ".");
+        n_max = std::max(n_max, n);
+    }
 
-    if (n==0) return f0;
-    if (n==1) return f1;
+    vector<int> fns(ns.size());
+    vector<size_t> beyond_memo;     // Indices into ns, in order of increasing n.
+    int n;
+    unsigned fnm2 = 0;
+    unsigned fnm1;  // Unsigned, as in fib_add.
+    unsigned fn;
+    {
+        std::lock_guard<std::mutex> lock(fib_memo_mutex);   // Commands may run fib concurrently.
+        vector<int>& terms = fib_memo_terms_for(f0, f1);
+        while (terms.size() <= static_cast<size_t>(n_max) && terms.size() < fib_memo_terms) {
+            terms.push_back(fib_add(terms[terms.size()-1], terms[terms.size()-2]));
+        }
 
-    int fnm2 = 0;
-    int fnm1 = f0;
-    int fn = f1;
+        for (size_t i = 0; i != ns.size(); ++i) {
+            if (static_cast<size_t>(ns[i]) < terms.size()) {
+                fns[i] = terms[ns[i]];
+            } else {
+                beyond_memo.push_back(i);
+            }
+        }
 
-    for (int i = 2; i <= n; ++i) {
-        fnm2 = fnm1;
-        fnm1 = fn;
-        fn = fnm1 + fnm2;
+        n = static_cast<int>(terms.size()) - 1;
+        fnm1 = static_cast<unsigned>(terms[n-1]);
+        fn = static_cast<unsigned>(terms[n]);
     }
+    std::sort(beyond_memo.begin(), beyond_memo.end(), [&](size_t a, size_t b) { return ns[a] < ns[b]; });
 
-    return fn;
-}
+    for (size_t i: beyond_memo) {
+        for (const int n_query = ns[i]; n < n_query; ++n) {
+            fnm2 = fnm1;
+            fnm1 = fn;
+            fn = fnm1 + fnm2;
+        }
+        fns[i] = static_cast<int>(fn);
+    }
 
+    return fns;
+}
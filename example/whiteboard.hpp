@@ -7,5 +7,6 @@
 std::string fizzbuzz(int n);
 int fact(int n);
 int fib(int n, int f0 = 0, int f1 = 1);
+std::vector<int> fib(const std::vector<int>& ns, int f0 = 0, int f1 = 1);
 
 #endif
@@ -0,0 +1,84 @@
+#include <cassert>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#include "fact_main.hpp"
+#include "fib_main.hpp"
+#include "fizzbuzz_main.hpp"
+#include "CLIMap.hpp"
+#include "CLIMapOutput.hpp"
+#include "CLIMapParallel.hpp"
+#include "CLIMapProfile.hpp"
+#include "CLIMapResultCache.hpp"
+
+#include "whiteboard_main.hpp"
+
+using std::cout;
+using std::endl;
+using std::string;
+
+int whiteboard_main(int, char**);
+int whiteboard_print_help_main(int, char**);
+int whiteboard_invalid_anyarg_main(int, char**);
+
+const char * whiteboard_prog_name;
+
+struct WhiteboardHelpHint { };   // Written only when an argument is invalid, so dispatch need not build it.
+
+std::ostream& operator<<(std::ostream& out, WhiteboardHelpHint) {
+    return out << "Run \"" << whiteboard_prog_name << " help\" for more information.\n";
+}
+
+int whiteboard_main(int argc, char **argv) {
+    static const CLIMap<> climap(CLIMapMatchPolicy::case_insensitive, {
+        {"fizzbuzz", climap_pure(climap_speculative(fizzbuzz_main))},
+        {"fact", climap_pure(climap_speculative(fact_main))},
+        {"fib", fib_main},
+        {"help", whiteboard_print_help_main},
+        {noarg, whiteboard_print_help_main},
+        {anyarg, whiteboard_invalid_anyarg_main}
+    });
+    whiteboard_prog_name = argv[0];
+    CLIMapOutputFormat format = CLIMapOutputFormat::text;
+    int args_to_skip = 0;
+    if (argc > 1 && std::strcmp(argv[1], "--ndjson") == 0) {
+        format = CLIMapOutputFormat::ndjson;
+        ++args_to_skip;
+    } else if (argc > 1 && std::strcmp(argv[1], "--binary") == 0) {
+        format = CLIMapOutputFormat::binary;
+        ++args_to_skip;
+    }
+    return climap.exec_main(argc, argv, WhiteboardHelpHint{}, format, args_to_skip);
+}
+
+int whiteboard_print_help_main(int argc, char **) {
+    assert(argc>0);
+    static const char usage[] =
+            " [--ndjson | --binary] <command>...\n"
+            "   --ndjson        Write results and errors as JSON, one object per line.\n"
+            "   --binary        Write results and errors as length prefixed binary records.\n"
+            "   fizzbuzz <n>    For some positive (>=1) integer n.\n"
+            "   fact <n>        Factorial of some non-negative integer n (n!).\n"
+            "   fib             Fibonacci series whereby fibonacci(n) = fibonacci(n-1) + fibonacci(n-2)\n"
+            "       f0 <z>      Set fibonacci(0), the zeroth number in the fibonacci series, to some integer z. Set to 0 by default.\n"
+            "       f1 <z>      Set fibonacci(1), the first number in the fibonacci series, to some integer z. Set to 1 by default.\n"
+            "       <n>         Find fibonacci(n), the nth number in the fibonacci series, for some non-negative integer n.\n";
+
+    if (CLIMapOutput::format() == CLIMapOutputFormat::text) {
+        cout << whiteboard_prog_name << usage;
+    } else {
+        // One result record holding the text, so that --ndjson and --binary output stays parseable.
+        CLIMapOutput::result("help", (string(whiteboard_prog_name) + usage).c_str());
+    }
+
+    return argmap_return_success(argc);
+}
+
+int whiteboard_invalid_anyarg_main(int argc, char **argv) {
+    assert(argc>0);
+    const char * arg = argv[0];
+    if (!CLIMapOutput::error("whiteboard", "invalid_argument", arg)) cout << "Invalid argument \"" << arg << "\"." << endl;
+    return ARGMAP_EXIT_INVALID_ARG;
+}
+
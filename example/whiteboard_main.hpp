@@ -0,0 +1,6 @@
+#ifndef WHITEBOARD_MAIN_GUARD
+#define WHITEBOARD_MAIN_GUARD
+
+int whiteboard_main(int argc, char **argv);
+
+#endif
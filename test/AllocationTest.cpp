@@ -0,0 +1,179 @@
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+// Allocation budgets for dispatch. Replaces the global operator new, and on glibc malloc, calloc and
+// realloc, with hooks that count the allocations made on the calling thread while counting is on,
+// then runs the maps of example/ and test/MapTestManual.cpp down their success, noarg, anyarg and
+// invalid argument paths. Dispatch itself allocates nothing; the budgets above zero are the
+// handlers' own. Sanitizers replace the allocator themselves, so the hooks are left out under them.
+
+#include <cstddef>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+#include "TestUtil.hpp"
+#include "whiteboard_main.hpp"
+
+#if defined(__has_feature)
+    #if __has_feature(address_sanitizer) || __has_feature(thread_sanitizer)
+        #define CLIMAP_SANITIZED
+    #endif
+#endif
+#if defined(__SANITIZE_ADDRESS__) || defined(__SANITIZE_THREAD__)
+    #define CLIMAP_SANITIZED
+#endif
+
+using std::string;
+using std::vector;
+
+int main_recurse(int argc, char **argv);    // test/MapTestManual.cpp
+
+#if !defined(CLIMAP_SANITIZED)
+
+namespace {
+
+thread_local bool allocations_counted = false;
+thread_local std::size_t allocations = 0;
+
+void count_allocation() {
+    if (allocations_counted) ++allocations;
+}
+
+}
+
+#if defined(__GLIBC__)
+extern "C" {
+    void * __libc_malloc(std::size_t size);
+    void * __libc_calloc(std::size_t count, std::size_t size);
+    void * __libc_realloc(void * ptr, std::size_t size);
+    void __libc_free(void * ptr);
+
+    void * malloc(std::size_t size) noexcept {
+        count_allocation();
+        return __libc_malloc(size);
+    }
+
+    void * calloc(std::size_t count, std::size_t size) noexcept {
+        count_allocation();
+        return __libc_calloc(count, size);
+    }
+
+    void * realloc(void * ptr, std::size_t size) noexcept {
+        count_allocation();
+        return __libc_realloc(ptr, size);
+    }
+}
+
+#define CLIMAP_RAW_MALLOC __libc_malloc
+#define CLIMAP_RAW_FREE __libc_free
+#else
+#define CLIMAP_RAW_MALLOC std::malloc
+#define CLIMAP_RAW_FREE std::free
+#endif
+
+void * operator new(std::size_t size) {
+    count_allocation();
+    void * ptr = CLIMAP_RAW_MALLOC(size == 0 ? 1 : size);
+    if (ptr == nullptr) throw std::bad_alloc();
+    return ptr;
+}
+
+void operator delete(void * ptr) noexcept {
+    CLIMAP_RAW_FREE(ptr);
+}
+
+void * operator new[](std::size_t size) {
+    return operator new(size);
+}
+
+void operator delete[](void * ptr) noexcept {
+    operator delete(ptr);
+}
+
+namespace {
+
+class NullBuffer : public std::streambuf {
+    protected:
+        int overflow(int c) override { return traits_type::not_eof(c); }
+        std::streamsize xsputn(const char *, std::streamsize count) override { return count; }
+};
+
+class DiscardCout {
+    // Handlers print; a null buffer takes it without allocating.
+    public:
+        DiscardCout(): cout_buffer{std::cout.rdbuf(&null_buffer)} { }
+        ~DiscardCout() { std::cout.rdbuf(cout_buffer); }
+
+    private:
+        NullBuffer null_buffer;
+        std::streambuf * cout_buffer;
+};
+
+std::size_t allocations_running(int (*main_function)(int, char **), const vector<string>& args) {
+    // Runs once to construct the maps' static state, then counts a second run.
+    vector<string> owned_args{"prog"};
+    owned_args.insert(owned_args.end(), args.begin(), args.end());
+    TestArgv argv(owned_args);
+
+    DiscardCout discard;
+    main_function(argv.argc(), argv.argv());
+    allocations = 0;
+    allocations_counted = true;
+    main_function(argv.argc(), argv.argv());
+    allocations_counted = false;
+    return allocations;
+}
+
+bool counting_works() {
+    allocations = 0;
+    allocations_counted = true;
+    delete new int(1);
+    void * block = std::malloc(64);
+    allocations_counted = false;
+    std::free(block);
+    return allocations == 2;
+}
+
+}
+
+BOOST_AUTO_TEST_CASE(allocation_hooks) {
+    BOOST_REQUIRE(counting_works());
+}
+
+BOOST_AUTO_TEST_CASE(allocation_example_success) {
+    BOOST_TEST(allocations_running(whiteboard_main, {"fact", "5"}) == 0u);
+    BOOST_TEST(allocations_running(whiteboard_main, {"fizzbuzz", "1", "2", "3", "FACT", "12"}) == 0u);
+    BOOST_TEST(allocations_running(whiteboard_main, {"--ndjson", "fizzbuzz", "15", "fact", "3"}) == 0u);
+    BOOST_TEST(allocations_running(whiteboard_main, {"--binary", "fact", "3"}) == 0u);
+    // Each of the two runs of fib queries allocates its queries and its answers.
+    BOOST_TEST(allocations_running(whiteboard_main, {"fib", "10", "20", "f0", "2", "30"}) == 4u);
+}
+
+BOOST_AUTO_TEST_CASE(allocation_example_noarg_and_anyarg) {
+    BOOST_TEST(allocations_running(whiteboard_main, {}) == 0u);
+    BOOST_TEST(allocations_running(whiteboard_main, {"fib"}) == 0u);
+    BOOST_TEST(allocations_running(whiteboard_main, {"bogus"}) == 0u);
+    BOOST_TEST(allocations_running(whiteboard_main, {"fact", "x"}) == 0u);
+    BOOST_TEST(allocations_running(whiteboard_main, {"--ndjson", "fizzbuzz", "x"}) == 0u);
+}
+
+BOOST_AUTO_TEST_CASE(allocation_example_invalid_arg) {
+    BOOST_TEST(allocations_running(whiteboard_main, {"fact", "99999999999"}) == 0u);
+    BOOST_TEST(allocations_running(whiteboard_main, {"fib", "f1"}) == 0u);
+    // stoi's exception and its message.
+    BOOST_TEST(allocations_running(whiteboard_main, {"fib", "f0", "x"}) == 2u);
+}
+
+BOOST_AUTO_TEST_CASE(allocation_map_test_manual) {
+    BOOST_TEST(allocations_running(main_recurse, {"succeed", "down", "succeed", "fact", "5"}) == 0u);
+    BOOST_TEST(allocations_running(main_recurse, {}) == 0u);
+    BOOST_TEST(allocations_running(main_recurse, {"fail"}) == 0u);
+    BOOST_TEST(allocations_running(main_recurse, {"down", "unrecognised"}) == 0u);
+    BOOST_TEST(allocations_running(main_recurse, {"print", "anything"}) == 0u);
+}
+
+#endif
@@ -0,0 +1,93 @@
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+#include "CLIMapAsync.hpp"
+
+#if __cplusplus >= 202002L && defined(__cpp_impl_coroutine)
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+using std::string;
+using std::vector;
+
+namespace {
+
+vector<string> async_log;
+
+struct LogOnDestruction {
+    string message;
+    ~LogOnDestruction() { async_log.push_back(message); }
+};
+
+CLIMapTask<int> count_to(int argc, char **argv) {
+    // Consumes the following integer n, logging and checkpointing n times.
+    LogOnDestruction guard{string("unwound ") + argv[0]};
+    int n = std::stoi(argv[1]);
+    for (int i = 0; i != n; ++i) {
+        async_log.push_back(string(argv[0]) + " " + std::to_string(i));
+        co_await climap_checkpoint();
+    }
+    co_return argmap_return_success(argc, 1);
+}
+
+int sync_log(int argc, char **argv) {
+    async_log.push_back(string("sync ") + argv[0]);
+    return argmap_return_success(argc);
+}
+
+CLIMapTask<int> forever(int argc, char **) {
+    LogOnDestruction guard{"unwound forever"};
+    while (true) co_await climap_checkpoint();
+    co_return argc;
+}
+
+const CLIMapAsync<> async_map {
+    {"a", count_to},
+    {"b", count_to},
+    {"s", sync_log},
+    {"forever", forever}
+};
+
+}
+
+BOOST_AUTO_TEST_CASE(async_interleaves_commands) {
+    async_log.clear();
+    char prog[] = "prog", a[] = "a", b[] = "b", s[] = "s", two[] = "2";
+    char *argv_1[] = {prog, a, two, s};
+    char *argv_2[] = {prog, b, two};
+
+    CLIMapScheduler scheduler;
+    auto job_1 = scheduler.spawn(async_map.async_exec_main(4, argv_1));
+    auto job_2 = scheduler.spawn(async_map.async_exec_main(3, argv_2));
+    scheduler.run();
+
+    BOOST_TEST((job_1->status() == CLIMapJobStatus::done));
+    BOOST_TEST(job_1->result() == 0);
+    BOOST_TEST(job_2->result() == 0);
+    vector<string> expected{"a 0", "b 0", "a 1", "b 1", "unwound a", "sync s", "unwound b"};
+    BOOST_TEST(async_log == expected, boost::test_tools::per_element());
+}
+
+BOOST_AUTO_TEST_CASE(async_cancel_and_deadline) {
+    async_log.clear();
+    char prog[] = "prog", f[] = "forever";
+    char *argv[] = {prog, f};
+
+    CLIMapScheduler scheduler;
+    auto timed = scheduler.spawn(async_map.async_exec_main(2, argv), std::chrono::milliseconds(5));
+    auto cancelled = scheduler.spawn(async_map.async_exec_main(2, argv));
+    auto never_started = scheduler.spawn(async_map.async_exec_main(2, argv));
+    never_started->cancel();
+    for (int i = 0; i != 10; ++i) scheduler.run_one();
+    cancelled->cancel();
+    scheduler.run();
+
+    BOOST_TEST((timed->status() == CLIMapJobStatus::deadline_exceeded));
+    BOOST_TEST((cancelled->status() == CLIMapJobStatus::cancelled));
+    BOOST_TEST((never_started->status() == CLIMapJobStatus::cancelled));
+    BOOST_TEST(async_log == (vector<string>{"unwound forever", "unwound forever"}), boost::test_tools::per_element());
+}
+
+#endif
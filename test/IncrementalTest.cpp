@@ -0,0 +1,169 @@
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "CLIMapIncremental.hpp"
+#include "CLIMapOutput.hpp"
+#include "TestUtil.hpp"
+
+using std::string;
+using std::vector;
+
+namespace {
+
+int incremental_calls = 0;
+
+int take_number(int argc, char **argv) {
+    // Takes one argument, which must be a number.
+    ++incremental_calls;
+    if (argc == 1) return ARGMAP_EXIT_INVALID_ARG;
+    char * end;
+    std::strtol(argv[1], &end, 10);
+    if (*end != '\0') return ARGMAP_EXIT_INVALID_ARG;
+    return argmap_return_success(argc, 1);
+}
+
+int take_rest(int, char **) {
+    ++incremental_calls;
+    return 0;
+}
+
+int no_command(int argc, char **) {
+    ++incremental_calls;
+    return argmap_return_success(argc);
+}
+
+int nested_numbers(int argc, char **argv) {
+    // A nested map of numbers, as fib's.
+    static const CLIMap<> climap {
+        {"add", take_number},
+        {"sub", take_number}
+    };
+    return climap.exec(argc, argv);
+}
+
+const CLIMap<>& incremental_map() {
+    static const CLIMap<> climap {
+        {"add", take_number},
+        {"sub", take_number},
+        {"rest", take_rest},
+        {"nested", nested_numbers},
+        {noarg, no_command}
+    };
+    return climap;
+}
+
+int exec_incremental(CLIMap<>::Incremental& incremental, vector<string> args, CLIMapOutputFormat format = CLIMapOutputFormat::text) {
+    args.insert(args.begin(), "prog");
+    TestArgv argv(args);
+    incremental_calls = 0;
+    return incremental.exec_main(argv.argc(), argv.argv(), format);
+}
+
+int exec_whole(vector<string> args) {
+    args.insert(args.begin(), "prog");
+    TestArgv argv(args);
+    return incremental_map().exec_main(argv.argc(), argv.argv());
+}
+
+}
+
+BOOST_AUTO_TEST_CASE(incremental_reruns_from_first_change) {
+    CLIMap<>::Incremental incremental(incremental_map());
+    BOOST_TEST(exec_incremental(incremental, {"add", "1", "sub", "2", "add", "3"}) == 0);
+    BOOST_TEST(incremental_calls == 3);
+    BOOST_TEST_REQUIRE(incremental.steps().size() == 3u);
+    BOOST_TEST(incremental.steps()[1].arg_index == 3);
+    BOOST_TEST(incremental.steps()[1].key_index == 1u);
+    BOOST_TEST(incremental.steps()[1].argc_left_or_error == 2);
+
+    // Editing the last argument calls only its handler.
+    BOOST_TEST(exec_incremental(incremental, {"add", "1", "sub", "2", "add", "4"}) == 0);
+    BOOST_TEST(incremental_calls == 1);
+
+    // Appending calls the last handler again, as the argument after its own changed, then the new one.
+    BOOST_TEST(exec_incremental(incremental, {"add", "1", "sub", "2", "add", "4", "sub"}) == ARGMAP_EXIT_INVALID_ARG);
+    BOOST_TEST(incremental_calls == 2);
+    BOOST_TEST(exec_incremental(incremental, {"add", "1", "sub", "2", "add", "4", "sub", "5"}) == 0);
+    BOOST_TEST(incremental_calls == 1);
+    BOOST_TEST(incremental.steps()[1].argc_left_or_error == 4);    // Counted against the longer line.
+
+    // An unchanged command line calls nothing.
+    BOOST_TEST(exec_incremental(incremental, {"add", "1", "sub", "2", "add", "4", "sub", "5"}) == 0);
+    BOOST_TEST(incremental_calls == 0);
+
+    // Editing the first argument calls every handler.
+    BOOST_TEST(exec_incremental(incremental, {"sub", "1", "sub", "2", "add", "4", "sub", "5"}) == 0);
+    BOOST_TEST(incremental_calls == 4);
+}
+
+BOOST_AUTO_TEST_CASE(incremental_failures_and_truncation) {
+    CLIMap<>::Incremental incremental(incremental_map());
+    BOOST_TEST(exec_incremental(incremental, {"add", "x", "sub", "2"}) == ARGMAP_EXIT_INVALID_ARG);
+    BOOST_TEST(exec_incremental(incremental, {"add", "1", "sub", "2"}) == 0);
+    BOOST_TEST(incremental_calls == 2);
+
+    // A step is called again when the argument after those it took changes, as a bulk handler's might.
+    BOOST_TEST(exec_incremental(incremental, {"add", "1", "sub", "2", "mul"}) == 1);
+    BOOST_TEST(incremental_calls == 1);
+    BOOST_TEST(exec_incremental(incremental, {"add", "1", "sub", "2", "rest", "a", "b"}) == 0);
+    BOOST_TEST(incremental_calls == 2);
+    BOOST_TEST(exec_incremental(incremental, {"add", "1", "sub"}) == ARGMAP_EXIT_INVALID_ARG);
+    BOOST_TEST(incremental_calls == 1);
+
+    BOOST_TEST(exec_incremental(incremental, {}) == 0);
+    BOOST_TEST(incremental_calls == 1);
+    BOOST_TEST_REQUIRE(incremental.steps().size() == 1u);
+    BOOST_TEST(incremental.steps()[0].arg_index == 0);
+}
+
+BOOST_AUTO_TEST_CASE(incremental_matches_exec_main) {
+    // Every prefix of some edited command lines, typed in order, gives exec_main's result.
+    const vector<vector<string>> lines {
+        {"add", "1", "sub", "2", "rest", "x", "add", "3"},
+        {"add", "1", "sub", "y", "add", "3"},
+        {"sub", "1", "bogus", "2"},
+        {"add", "10", "add", "20", "add", "30", "sub", "40"},
+    };
+    CLIMap<>::Incremental incremental(incremental_map());
+    for (const vector<string>& line: lines) {
+        for (std::size_t length = 0; length <= line.size(); ++length) {
+            const vector<string> prefix(line.begin(), line.begin() + length);
+            BOOST_TEST(exec_incremental(incremental, prefix) == exec_whole(prefix));
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(incremental_reruns_nested_maps_whole) {
+    // Only the top level map's steps are kept, so editing a nested map's last argument calls its every handler again.
+    CLIMap<>::Incremental incremental(incremental_map());
+    BOOST_TEST(exec_incremental(incremental, {"add", "1", "nested", "add", "2", "sub", "3", "add", "4"}) == 0);
+    BOOST_TEST(incremental_calls == 4);
+    BOOST_TEST(incremental.steps().size() == 2u);
+    BOOST_TEST(exec_incremental(incremental, {"add", "1", "nested", "add", "2", "sub", "3", "add", "5"}) == 0);
+    BOOST_TEST(incremental_calls == 3);
+}
+
+BOOST_AUTO_TEST_CASE(incremental_output_format) {
+    // Steps kept from a run in another format are not, as their output was written in it.
+    CLIMap<>::Incremental incremental(incremental_map());
+    BOOST_TEST(exec_incremental(incremental, {"add", "1", "sub", "2"}) == 0);
+    BOOST_TEST(exec_incremental(incremental, {"add", "1", "sub", "2"}, CLIMapOutputFormat::ndjson) == 0);
+    BOOST_TEST(incremental_calls == 2);
+    BOOST_TEST(exec_incremental(incremental, {"add", "1", "sub", "3"}, CLIMapOutputFormat::ndjson) == 0);
+    BOOST_TEST(incremental_calls == 1);
+
+    // Each run writes its outcome, even when unchanged.
+    string output;
+    {
+        CaptureCout capture;
+        exec_incremental(incremental, {"add", "1", "bogus"}, CLIMapOutputFormat::ndjson);
+        exec_incremental(incremental, {"add", "1", "bogus"}, CLIMapOutputFormat::ndjson);
+        output = capture.str();
+    }
+    const string outcome = "{\"type\":\"error\",\"code\":\"unrecognised_argument\",\"index\":3,\"argument\":\"bogus\"}\n";
+    BOOST_TEST(output == outcome + outcome);
+}
@@ -0,0 +1,161 @@
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "CLIMap.hpp"
+#include "CLIMapKeyStats.hpp"
+#include "CLIMapParallel.hpp"
+#include "TestUtil.hpp"
+
+using std::string;
+using std::vector;
+
+namespace {
+
+vector<int> key_order_handled;
+
+template<int handler>
+int record_handler(int argc, char **) {
+    key_order_handled.push_back(handler);
+    return argmap_return_success(argc);
+}
+
+int record_run(int argc, char **, int run) {
+    key_order_handled.push_back(run);
+    return argmap_return_consumed(argc, run);
+}
+
+int take_to_key(int argc, char **argv) {
+    // Takes the arguments up to the next key of make_speculative_map's, so prints nothing, to run on any thread.
+    int taken = 0;
+    while (taken + 1 < argc && std::strcmp(argv[taken + 1], "echo") != 0 && std::strcmp(argv[taken + 1], "x") != 0) ++taken;
+    return argmap_return_success(argc, taken);
+}
+
+bool is_gamma(const char * arg) {
+    return std::strcmp(arg, "gamma") == 0;
+}
+
+CLIMap<> make_key_order_map() {
+    // Raw arg keys alpha, beta, alpha (never matched), gamma (shadowed by is_gamma) and delta.
+    return CLIMap<>::Builder()
+        .add("alpha", record_handler<0>)
+        .add("beta", record_handler<1>)
+        .add("alpha", record_handler<2>)
+        .add(is_gamma, record_handler<3>)
+        .add("gamma", record_handler<4>)
+        .add("delta", record_handler<5>)
+        .freeze();
+}
+
+CLIMap<> make_speculative_map() {
+    return CLIMap<>::Builder()
+        .add("echo", climap_speculative(take_to_key))
+        .add("x", climap_speculative(take_to_key))
+        .freeze();
+}
+
+vector<int> dispatch(const CLIMap<>& climap, vector<string> args) {
+    args.insert(args.begin(), "prog");
+    TestArgv argv(args);
+    key_order_handled.clear();
+    climap.exec_main(argv.argc(), argv.argv());
+    return key_order_handled;
+}
+
+string last_map_in_profile() {
+    std::ostringstream out;
+    CLIMapKeyStats::dump(out);
+    const string profile = out.str();
+    return profile.substr(profile.rfind("map "));
+}
+
+void clear_profile() {
+    std::istringstream empty("climap-key-profile 1\n");
+    CLIMapKeyStats::load(empty);
+}
+
+}
+
+BOOST_AUTO_TEST_CASE(key_order_count_and_dump) {
+    CLIMapKeyStats::set_mode(CLIMapKeyStats::Mode::count);
+    const CLIMap<> climap = make_key_order_map();
+    CLIMapKeyStats::set_mode(CLIMapKeyStats::Mode::off);
+    BOOST_CHECK(dispatch(climap, {"alpha", "beta", "alpha", "delta", "delta", "delta"}) == (vector<int>{0, 1, 0, 5, 5, 5}));
+
+    const string map_profile = last_map_in_profile();
+    BOOST_CHECK(map_profile.find(" 5\n0 2 alpha\n1 1 beta\n2 0 alpha\n3 0 gamma\n4 3 delta\n") != string::npos);
+}
+
+BOOST_AUTO_TEST_CASE(key_order_from_profile) {
+    // Hot duplicates and delta first, without changing which handlers run.
+    CLIMapKeyStats::set_mode(CLIMapKeyStats::Mode::count);
+    string profile = "climap-key-profile 1\n" + last_map_in_profile().substr(0, last_map_in_profile().find('\n') + 1)
+        + "0 1 alpha\n1 0 beta\n2 900 alpha\n3 800 gamma\n4 1000 delta\n";
+    std::istringstream in(profile);
+    BOOST_REQUIRE(CLIMapKeyStats::load(in));
+    const CLIMap<> climap = make_key_order_map();
+    CLIMapKeyStats::set_mode(CLIMapKeyStats::Mode::off);
+    clear_profile();
+
+    BOOST_CHECK(dispatch(climap, {"delta", "alpha", "gamma", "beta"}) == (vector<int>{5, 0, 3, 1}));
+    BOOST_CHECK(dispatch(climap, {"alpha", "epsilon"}) == (vector<int>{0}));
+
+    // Counts are still reported by declaration order.
+    BOOST_CHECK(last_map_in_profile().find(" 5\n0 2 alpha\n1 1 beta\n2 0 alpha\n3 1 gamma\n4 1 delta\n") != string::npos);
+}
+
+BOOST_AUTO_TEST_CASE(key_order_adaptive) {
+    CLIMapKeyStats::set_mode(CLIMapKeyStats::Mode::adapt);
+    const CLIMap<> climap = make_key_order_map();
+    CLIMapKeyStats::set_mode(CLIMapKeyStats::Mode::off);
+
+    for (int round = 0; round != 100; ++round) {
+        BOOST_REQUIRE(dispatch(climap, {"delta", "delta", "gamma", "alpha", "delta", "beta"}) == (vector<int>{5, 5, 3, 0, 5, 1}));
+    }
+    BOOST_CHECK(dispatch(climap, {"alpha", "zeta"}) == (vector<int>{0}));
+}
+
+BOOST_AUTO_TEST_CASE(key_order_rejects_other_files) {
+    std::istringstream not_profile("fizzbuzz 15\n");
+    BOOST_CHECK(!CLIMapKeyStats::load(not_profile));
+    std::istringstream truncated("climap-key-profile 1\nmap 1f 3\n0 1 alpha\n");
+    BOOST_CHECK(!CLIMapKeyStats::load(truncated));
+}
+
+BOOST_AUTO_TEST_CASE(key_order_count_bulk_runs) {
+    // Each argument of a run counts once, as if dispatched one by one, and so does the one ending it.
+    CLIMapKeyStats::set_mode(CLIMapKeyStats::Mode::count);
+    const CLIMap<> climap = CLIMap<>::Builder()
+        .add("alpha", record_handler<0>)
+        .add("delta", climap_bulk(record_run))
+        .freeze();
+    CLIMapKeyStats::set_mode(CLIMapKeyStats::Mode::off);
+    BOOST_CHECK(dispatch(climap, {"delta", "delta", "delta", "alpha", "delta", "beta"}) == (vector<int>{3, 0, 1}));
+
+    BOOST_CHECK(last_map_in_profile().find(" 2\n0 1 alpha\n1 4 delta\n") != string::npos);
+}
+
+BOOST_AUTO_TEST_CASE(key_order_count_parallel_dispatch) {
+    // Looking ahead of speculative handlers counts nothing, so counts are as sequential dispatch's.
+    const vector<string> args{"echo", "a", "x", "echo", "b", "x", "echo"};
+    CLIMapKeyStats::set_mode(CLIMapKeyStats::Mode::count);
+    const CLIMap<> sequential_map = make_speculative_map();
+    CLIMapKeyStats::set_mode(CLIMapKeyStats::Mode::off);
+    dispatch(sequential_map, args);
+    const string sequential_profile = last_map_in_profile();
+    BOOST_CHECK(sequential_profile.find(" 2\n0 3 echo\n1 2 x\n") != string::npos);
+
+    CLIMapKeyStats::set_mode(CLIMapKeyStats::Mode::count);
+    const CLIMap<> parallel_map = make_speculative_map();
+    CLIMapKeyStats::set_mode(CLIMapKeyStats::Mode::off);
+    CLIMapThreadPool pool(4);
+    CLIMapWorkers::install(&pool);
+    dispatch(parallel_map, args);
+    CLIMapWorkers::install(nullptr);
+    BOOST_CHECK_EQUAL(last_map_in_profile(), sequential_profile);
+}
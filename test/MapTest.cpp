@@ -0,0 +1,240 @@
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "CLIMap.hpp"
+#include "TestUtil.hpp"
+
+using std::string;
+using std::vector;
+
+namespace {
+
+vector<string> handled;
+int matching_function_calls = 0;
+
+int record_handled(int argc, char **argv) {
+    handled.push_back(argv[0]);
+    return argmap_return_success(argc);
+}
+
+int record_first(int argc, char **argv) {
+    handled.push_back(string("first ") + argv[0]);
+    return argmap_return_success(argc);
+}
+
+int record_noarg(int argc, char **) {
+    handled.push_back("noarg");
+    return argmap_return_success(argc);
+}
+
+int record_anyarg(int argc, char **argv) {
+    handled.push_back(string("anyarg ") + argv[0]);
+    return argmap_return_success(argc);
+}
+
+bool counted_is_long_key(const char * arg) {
+    ++matching_function_calls;
+    return std::strcmp(arg, "a_key_longer_than_eight") == 0;
+}
+
+bool never_matches(const char *) {
+    ++matching_function_calls;
+    return false;
+}
+
+bool is_digits(const char * arg) {
+    return *arg != '\0' && std::strspn(arg, "0123456789") == std::strlen(arg);
+}
+
+bool counted_is_digits(const char * arg) {
+    ++matching_function_calls;
+    return is_digits(arg);
+}
+
+int bulk_take = 0;  // How many of each run record_run consumes, all if 0.
+
+int record_run(int argc, char **argv, int run) {
+    const int consumed = bulk_take != 0 && bulk_take < run ? bulk_take : run;
+    handled.push_back("run " + std::to_string(run) + " from " + argv[0]);
+    return argmap_return_consumed(argc, consumed);
+}
+
+void reset() {
+    handled.clear();
+    matching_function_calls = 0;
+    bulk_take = 0;
+}
+
+}
+
+BOOST_AUTO_TEST_CASE(map_raw_keys_longer_than_prefix) {
+    reset();
+    const CLIMap<> climap {
+        {"a_key_longer_than_eight", record_handled},
+        {"a_key_longer_than_nine", record_first},
+        {"a_key_l", record_first},
+        {"", record_first}
+    };
+    char prog[] = "prog", arg1[] = "a_key_longer_than_eight", arg2[] = "a_key_longer_than_nine", arg3[] = "a_key_l", arg4[] = "";
+    char *argv[] = {prog, arg1, arg2, arg3, arg4};
+    BOOST_TEST(climap.exec_main(5, argv) == 0);
+    BOOST_TEST(handled == (vector<string>{"a_key_longer_than_eight", "first a_key_longer_than_nine", "first a_key_l", "first "}), boost::test_tools::per_element());
+}
+
+BOOST_AUTO_TEST_CASE(map_declaration_order_priority) {
+    reset();
+    const CLIMap<> climap {
+        {never_matches, record_first},
+        {"dup", record_first},
+        {counted_is_long_key, record_first},
+        {"dup", record_handled},
+        {"a_key_longer_than_eight", record_handled},
+        {anyarg, record_anyarg}
+    };
+    char prog[] = "prog", arg1[] = "dup", arg2[] = "a_key_longer_than_eight", arg3[] = "other";
+    char *argv[] = {prog, arg1, arg2, arg3};
+    BOOST_TEST(climap.exec_main(4, argv) == 0);
+    BOOST_TEST(handled == (vector<string>{"first dup", "first a_key_longer_than_eight", "anyarg other"}), boost::test_tools::per_element());
+    // "dup" matches a raw key declared before counted_is_long_key, so only never_matches is called for it.
+    BOOST_TEST(matching_function_calls == 1 + 2 + 2);
+}
+
+BOOST_AUTO_TEST_CASE(map_noarg_and_anyarg_in_loop) {
+    reset();
+    const CLIMap<> climap {
+        {noarg, record_noarg},
+        {"known", record_handled},
+        {anyarg, record_anyarg}
+    };
+    char prog[] = "prog", arg1[] = "known", arg2[] = "unknown";
+    char *argv[] = {prog, arg1, arg2};
+    BOOST_TEST(climap.exec(1, argv) == 0);
+    BOOST_TEST(climap.exec(3, argv) == 1);  // anyarg only matches the first argument under exec.
+    BOOST_TEST(handled == (vector<string>{"noarg", "known"}), boost::test_tools::per_element());
+    BOOST_CHECK_THROW(climap.exec(1, argv, 1), std::domain_error);
+}
+
+BOOST_AUTO_TEST_CASE(map_builder_freeze) {
+    reset();
+    CLIMap<>::Builder builder;
+    for (const char * key: {"alpha", "a_key_longer_than_eight"}) {
+        string owned_key(key);
+        builder.add(owned_key, record_handled);   // owned_key goes out of scope before freeze.
+    }
+    builder.add("alpha", record_first).add(noarg, record_noarg).add(anyarg, record_anyarg);
+    BOOST_TEST(builder.size() == 5u);
+
+    const CLIMap<> frozen = builder.freeze();
+    builder.add("late", record_handled);
+    const CLIMap<> copied = frozen;
+
+    char prog[] = "prog", arg1[] = "a_key_longer_than_eight", arg2[] = "alpha", arg3[] = "late";
+    char *argv[] = {prog, arg1, arg2, arg3};
+    BOOST_TEST(copied.exec_main(4, argv) == 0);
+    BOOST_TEST(frozen.exec(1, argv) == 0);
+    BOOST_TEST(handled == (vector<string>{"a_key_longer_than_eight", "alpha", "anyarg late", "noarg"}), boost::test_tools::per_element());
+}
+
+BOOST_AUTO_TEST_CASE(map_from_constexpr_array) {
+    reset();
+    static constexpr CLIMap<>::RawPairType climap_keys[] {
+        {"known", record_handled},
+        {counted_is_long_key, record_first},
+        {anyarg, record_anyarg}
+    };
+    const CLIMap<> climap(climap_keys);
+    char prog[] = "prog", arg1[] = "a_key_longer_than_eight", arg2[] = "known", arg3[] = "other";
+    char *argv[] = {prog, arg1, arg2, arg3};
+    BOOST_TEST(climap.exec_main(4, argv) == 0);
+    BOOST_TEST(handled == (vector<string>{"first a_key_longer_than_eight", "known", "anyarg other"}), boost::test_tools::per_element());
+}
+
+BOOST_AUTO_TEST_CASE(map_case_insensitive) {
+    reset();
+    const CLIMap<> climap(CLIMapMatchPolicy::case_insensitive, {
+        {"fib", record_handled},
+        {"A_Key_Longer_Than_Thirty_Two_Bytes_In_All", record_handled},
+        {"größe", record_handled},
+        {"\xFF", record_handled},
+        {anyarg, record_anyarg}
+    });
+    char prog[] = "prog", arg1[] = "FIB", arg2[] = "a_key_longer_than_thirty_two_bytes_in_ALL", arg3[] = "GRÖẞE",
+         arg4[] = "\xFF", arg5[] = "grosse", arg6[] = "Fib";
+    char *argv[] = {prog, arg1, arg2, arg3, arg4, arg5, arg6};
+    BOOST_TEST(climap.exec_main(7, argv) == 0);
+    BOOST_TEST(handled == (vector<string>{"FIB", "a_key_longer_than_thirty_two_bytes_in_ALL", "GRÖẞE", "\xFF", "anyarg grosse", "Fib"}), boost::test_tools::per_element());
+
+    const CLIMap<> exact {
+        {"fib", record_handled}
+    };
+    BOOST_TEST(exact.exec(2, argv) == 1);
+}
+
+BOOST_AUTO_TEST_CASE(case_fold_utf8) {
+    const string cases[][2] = {
+        {"HELLO, World", "hello, world"},
+        {"ABCDEFGHIJKLMNOPQRSTUVWXYZ@[`{0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ", "abcdefghijklmnopqrstuvwxyz@[`{0123456789abcdefghijklmnopqrstuvwxyz"},
+        {"ΣΊΣΥΦΟΣ", "σίσυφοσ"},
+        {"\xE2\x84\xAA", "k"},                  // KELVIN SIGN folds to one byte.
+        {"\xC8\xBA", "\xE2\xB1\xA5"},           // U+023A folds to three bytes.
+        {"\xF0\x90\x90\x80", "\xF0\x90\x90\xA8"},   // DESERET CAPITAL LONG I.
+        {"A\xC0\xC1\x80Z\xE2\x84", "a\xC0\xC1\x80z\xE2\x84"}  // Malformed bytes are unchanged.
+    };
+    for (const auto& c: cases) {
+        vector<char> folded(CLIMapCaseFold::capacity(c[0].size()));
+        std::size_t length = CLIMapCaseFold::fold(c[0].c_str(), c[0].size(), folded.data());
+        BOOST_TEST(string(folded.data(), length) == c[1]);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(map_bulk_runs) {
+    reset();
+    const CLIMap<> climap {
+        {"7", record_handled},
+        {is_digits, climap_bulk(record_run)},
+        {"next", record_handled}
+    };
+    TestArgv argv({"prog", "1", "2", "3", "next", "4", "7", "5", "6"});
+    BOOST_TEST(climap.exec_main(argv.argc(), argv.argv()) == 0);
+    // "7" matches its raw key, declared first, so ends the run.
+    BOOST_TEST(handled == (vector<string>{"run 3 from 1", "next", "run 1 from 4", "7", "run 2 from 5"}), boost::test_tools::per_element());
+
+    // Arguments a handler leaves are dispatched again.
+    reset();
+    bulk_take = 2;
+    BOOST_TEST(climap.exec_main(4, argv.argv()) == 0);
+    BOOST_TEST(handled == (vector<string>{"run 3 from 1", "run 1 from 3"}), boost::test_tools::per_element());
+
+    // Runs longer than CLIMAP_BULK_RUN_LIMIT are split.
+    reset();
+    vector<string> many_args(CLIMAP_BULK_RUN_LIMIT + 10, "9");
+    many_args[0] = "prog";
+    TestArgv many_argv(many_args);
+    BOOST_TEST(climap.exec_main(many_argv.argc(), many_argv.argv()) == 0);
+    BOOST_TEST(handled == (vector<string>{"run " + std::to_string(CLIMAP_BULK_RUN_LIMIT) + " from 9", "run 9 from 9"}), boost::test_tools::per_element());
+}
+
+BOOST_AUTO_TEST_CASE(map_bulk_runs_match_each_argument_once) {
+    reset();
+    const CLIMap<> climap {
+        {"7", record_handled},
+        {counted_is_digits, climap_bulk(record_run)},
+        {"next", record_handled}
+    };
+    TestArgv argv({"prog", "1", "2", "3", "next", "4", "7", "5", "6"});
+    BOOST_TEST(climap.exec_main(argv.argc(), argv.argv()) == 0);
+    BOOST_TEST(handled == (vector<string>{"run 3 from 1", "next", "run 1 from 4", "7", "run 2 from 5"}), boost::test_tools::per_element());
+    // Once for each argument but "7", whose raw key is declared before the matching function.
+    BOOST_TEST(matching_function_calls == 7);
+
+    // Nor are the arguments a handler leaves, or the one ending its run, matched again.
+    reset();
+    bulk_take = 2;
+    BOOST_TEST(climap.exec_main(5, argv.argv()) == 0);
+    BOOST_TEST(handled == (vector<string>{"run 3 from 1", "run 1 from 3", "next"}), boost::test_tools::per_element());
+    BOOST_TEST(matching_function_calls == 4);
+}
@@ -23,7 +23,7 @@
 #include <iostream>
 #include <string>
 #include <sstream>
-#include <unordered_map>
+#include <vector>
 
 #include "CLIMap.hpp"
 
@@ -53,7 +53,7 @@ int print_arg(int argc, char **argv) {
 }
 
 int print_arg_passthrough(int argc, char **argv) {
-    constexpr CLIMap<> argmap {
+    static const CLIMap<> argmap {
         {anyarg, print_arg}
     };
     cout << "print_arg_passthrough" << endl;
@@ -104,7 +104,7 @@ int fizzbuzz(int argc, char **argv) {
 }
 
 int fizzbuzz_passthrough(int argc, char **argv) {
-    constexpr CLIMap<> argmap {
+    static const CLIMap<> argmap {
         {anyarg, fizzbuzz}
     };
     cout << "fizzbuzz_passthrough" << endl;
@@ -118,21 +118,31 @@ int fizzbuzz_passthrough(int argc, char **argv) {
 
 template<class T>
 T fib_dp(const T& n, const T& F0 = T(0), const T& F1 = T(1), bool clear_fib_map = false) {
-	static std::unordered_map< T, std::unordered_map< T, std::unordered_map<T,T> > > fib_map;
+	// Memoises the first fib_memo_size numbers of the series for the most recent F0, F1 only, so
+	// that memory stays bounded however many n and seeds are asked for.
+	static const std::size_t fib_memo_size = 4096;
+	static T memo_F0 = F0, memo_F1 = F1;
+	static std::vector<T> fib_memo;
     assert(n>=0);
 
-	if (clear_fib_map) fib_map.clear();
-
-	if (fib_map.find(F0) == fib_map.end() || fib_map.at(F0).find(F1) == fib_map.at(F0).end()) {
-		fib_map[F0][F1][0] = F0;
-		fib_map[F0][F1][1] = F1;
+	if (clear_fib_map || fib_memo.empty() || !(memo_F0 == F0) || !(memo_F1 == F1)) {
+		memo_F0 = F0;
+		memo_F1 = F1;
+		fib_memo.assign({F0, F1});
 	}
 
-	if (fib_map.at(F0).at(F1).find(n) == fib_map.at(F0).at(F1).end()) {
-		return (fib_map.at(F0).at(F1)[n] = fib_dp(n-T(1), F0, F1) + fib_dp(n-T(2), F0, F1));
+	while (T(fib_memo.size()) <= n && fib_memo.size() < fib_memo_size) {
+		fib_memo.push_back(fib_memo[fib_memo.size()-1] + fib_memo[fib_memo.size()-2]);
 	}
+	if (n < T(fib_memo.size())) return fib_memo[static_cast<std::size_t>(n)];
 
-	return fib_map.at(F0).at(F1).at(n);
+	T fnm1 = fib_memo[fib_memo.size()-2], fn = fib_memo.back();
+	for (T i = T(fib_memo.size()-1); i < n; i = i + T(1)) {
+		T fnp1 = fn + fnm1;
+		fnm1 = fn;
+		fn = fnp1;
+	}
+	return fn;
 }
 
 int fib(int argc, char **argv) {
@@ -145,7 +155,7 @@ int fib(int argc, char **argv) {
 }
 
 int fib_passthrough(int argc, char ** argv) {
-    constexpr CLIMap<> argmap {
+    static const CLIMap<> argmap {
         {anyarg, fib}
     };
     cout << "fib_passthrough" << endl;
@@ -170,7 +180,7 @@ int factorial(int argc, char **argv) {
 }
 
 int factorial_passthrough(int argc, char **argv) {
-    constexpr CLIMap<> argmap {
+    static const CLIMap<> argmap {
         {anyarg, factorial}
     };
     cout << "factorial_passthrough" << endl;
@@ -214,7 +224,7 @@ bool up_key_fn(const char * str) { // fails on the first go, alternates therafte
 
 int main_recurse(int argc, char** argv) {
     static int depth = 0;
-    constexpr CLIMap<> argmap {
+    static const CLIMap<> argmap {
         {"print", print_arg_passthrough},
         {"succeed", succeed},
         {"fail", fail},
@@ -245,7 +255,9 @@ int main_recurse(int argc, char** argv) {
     return ret;
 }
 
+#ifndef CLIMAP_MAP_TEST_MANUAL_NO_MAIN     // Defined where the tests link these maps in.
 int main(int argc, char **argv) {
     return main_recurse(argc, argv);
 }
+#endif
 
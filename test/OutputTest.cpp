@@ -0,0 +1,143 @@
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "CLIMapOutput.hpp"
+#include "CLIMapParallel.hpp"
+#include "TestUtil.hpp"
+#include "fib_main.hpp"
+
+using std::string;
+
+namespace {
+
+int output_result(int argc, char **argv) {
+    CLIMapOutput::result("echo", argv[1]);
+    CLIMapOutput::result("length", static_cast<long long>(string(argv[1]).size()) - 3);
+    return argmap_return_success(argc, 1);
+}
+
+int output_error(int, char **argv) {
+    if (!CLIMapOutput::error("fail", "failed", argv[0])) climap_cout() << "Failed.\n";
+    return ARGMAP_EXIT_INVALID_ARG;
+}
+
+int output_speculative(int argc, char **argv) {
+    CLIMapOutput::result("speculative", argv[0]);
+    return argmap_return_success(argc);
+}
+
+const CLIMap<>& output_test_map() {
+    static const CLIMap<> climap {
+        {"echo", output_result},
+        {"fail", output_error},
+        {"fib", fib_main},
+        {"a", climap_speculative(output_speculative)},
+        {"b", climap_speculative(output_speculative)}
+    };
+    return climap;
+}
+
+string exec_main_output(std::vector<string> args, CLIMapOutputFormat format, int * result = nullptr) {
+    TestArgv argv(args);
+    CaptureCout capture;
+    const int exec_result = output_test_map().exec_main(argv.argc(), argv.argv(), format);
+    if (result != nullptr) *result = exec_result;
+    return capture.str();
+}
+
+std::uint64_t read_little_endian(const string& bytes, std::size_t& at, int length) {
+    std::uint64_t value = 0;
+    for (int i = 0; i != length; ++i) value |= static_cast<std::uint64_t>(static_cast<unsigned char>(bytes[at + i])) << 8*i;
+    at += length;
+    return value;
+}
+
+}
+
+BOOST_AUTO_TEST_CASE(output_text_unchanged) {
+    int result = 0;
+    BOOST_CHECK_EQUAL(exec_main_output({"prog", "echo", "word", "fail"}, CLIMapOutputFormat::text, &result), "word\n1\nFailed.\n");
+    BOOST_CHECK_EQUAL(result, ARGMAP_EXIT_INVALID_ARG);
+}
+
+BOOST_AUTO_TEST_CASE(output_ndjson) {
+    BOOST_CHECK_EQUAL(exec_main_output({"prog", "echo", "q\"b\\\n\x01"}, CLIMapOutputFormat::ndjson),
+        "{\"type\":\"result\",\"command\":\"echo\",\"value\":\"q\\\"b\\\\\\u000a\\u0001\"}\n"
+        "{\"type\":\"result\",\"command\":\"length\",\"value\":3}\n");
+    BOOST_CHECK_EQUAL(exec_main_output({"prog", "echo", "ab"}, CLIMapOutputFormat::ndjson),
+        "{\"type\":\"result\",\"command\":\"echo\",\"value\":\"ab\"}\n"
+        "{\"type\":\"result\",\"command\":\"length\",\"value\":-1}\n");
+    BOOST_CHECK_EQUAL(exec_main_output({"prog", "fail"}, CLIMapOutputFormat::ndjson),
+        "{\"type\":\"error\",\"command\":\"fail\",\"code\":\"failed\",\"argument\":\"fail\"}\n"
+        "{\"type\":\"error\",\"code\":\"invalid_argument\"}\n");
+    int result = 0;
+    BOOST_CHECK_EQUAL(exec_main_output({"prog", "echo", "x", "bogus"}, CLIMapOutputFormat::ndjson, &result),
+        "{\"type\":\"result\",\"command\":\"echo\",\"value\":\"x\"}\n"
+        "{\"type\":\"result\",\"command\":\"length\",\"value\":-2}\n"
+        "{\"type\":\"error\",\"code\":\"unrecognised_argument\",\"index\":3,\"argument\":\"bogus\"}\n");
+    BOOST_CHECK_EQUAL(result, 1);
+}
+
+BOOST_AUTO_TEST_CASE(output_invalid_last_argument) {
+    // A handler reporting the argument it was called on, with none after it.
+    BOOST_CHECK_EQUAL(exec_main_output({"prog", "fib", "bogus"}, CLIMapOutputFormat::text),
+        "Fib argument \"bogus\" is invalid - not \"f0\", nor \"f1\", nor a non-negative integer.\n");
+    BOOST_CHECK_EQUAL(exec_main_output({"prog", "fib", "bogus"}, CLIMapOutputFormat::ndjson),
+        "{\"type\":\"error\",\"command\":\"fib\",\"code\":\"invalid_argument\",\"argument\":\"bogus\"}\n"
+        "{\"type\":\"error\",\"code\":\"invalid_argument\"}\n");
+}
+
+BOOST_AUTO_TEST_CASE(output_binary) {
+    const string bytes = exec_main_output({"prog", "echo", "hi", "bogus"}, CLIMapOutputFormat::binary);
+    std::size_t at = 0;
+    int records = 0;
+    string fields;
+    while (at < bytes.size()) {
+        const std::size_t end = read_little_endian(bytes, at, 4) + at;
+        BOOST_REQUIRE(end <= bytes.size());
+        fields += bytes[at++] == 0 ? "result" : "error";
+        while (at < end) {
+            const std::size_t name_length = static_cast<unsigned char>(bytes[at++]);
+            fields += ' ' + bytes.substr(at, name_length) + '=';
+            at += name_length;
+            if (bytes[at++] == 'i') {
+                fields += std::to_string(static_cast<std::int64_t>(read_little_endian(bytes, at, 8)));
+            } else {
+                const std::size_t length = read_little_endian(bytes, at, 4);
+                fields += bytes.substr(at, length);
+                at += length;
+            }
+        }
+        BOOST_CHECK_EQUAL(at, end);
+        fields += ';';
+        ++records;
+    }
+    BOOST_CHECK_EQUAL(records, 3);
+    BOOST_CHECK_EQUAL(fields, "result command=echo value=hi;result command=length value=-1;error code=unrecognised_argument index=3 argument=bogus;");
+}
+
+BOOST_AUTO_TEST_CASE(output_format_in_speculative_handlers) {
+    CLIMapThreadPool pool(2);
+    CLIMapWorkers::install(&pool);
+    const string output = exec_main_output({"prog", "a", "b", "a"}, CLIMapOutputFormat::ndjson);
+    CLIMapWorkers::install(nullptr);
+    BOOST_CHECK_EQUAL(output,
+        "{\"type\":\"result\",\"command\":\"speculative\",\"value\":\"a\"}\n"
+        "{\"type\":\"result\",\"command\":\"speculative\",\"value\":\"b\"}\n"
+        "{\"type\":\"result\",\"command\":\"speculative\",\"value\":\"a\"}\n");
+    BOOST_CHECK(CLIMapOutput::format() == CLIMapOutputFormat::text);
+}
+
+BOOST_AUTO_TEST_CASE(output_formats_need_writer) {
+    // Records other than text are only written once CLIMapOutput.hpp has installed its writer.
+    CLIMapOutputWriter::install(nullptr);
+    BOOST_CHECK_THROW(exec_main_output({"prog", "echo", "x"}, CLIMapOutputFormat::ndjson), std::invalid_argument);
+    BOOST_CHECK_EQUAL(exec_main_output({"prog", "echo", "x"}, CLIMapOutputFormat::text), "x\n-2\n");
+    CLIMapOutput::install();
+    BOOST_CHECK(CLIMapOutput::format() == CLIMapOutputFormat::text);
+}
@@ -0,0 +1,198 @@
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include "CLIMapParallel.hpp"
+#include "CLIMapResultCache.hpp"
+#include "TestUtil.hpp"
+
+using std::string;
+
+namespace {
+
+std::atomic<int> parallel_test_running{0};
+std::atomic<int> parallel_test_most_running{0};
+
+bool is_parallel_test_key(const string& arg) {
+    return arg == "echo" || arg == "take_two" || arg == "sequential" || arg == "throw" || arg == "count" || arg == "pure" || arg == "up";
+}
+
+int slow_echo(int argc, char **argv) {
+    // Echoes its arguments, up to the next key, slowly.
+    int running = ++parallel_test_running;
+    int most_running = parallel_test_most_running;
+    while (running > most_running && !parallel_test_most_running.compare_exchange_weak(most_running, running)) { }
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    int args_parsed = 0;
+    climap_cout() << argv[0];
+    while (args_parsed + 1 < argc && !is_parallel_test_key(argv[args_parsed + 1])) {
+        climap_cout() << ' ' << argv[++args_parsed];
+    }
+    climap_cout() << '\n';
+    --parallel_test_running;
+    return argmap_return_success(argc, args_parsed);
+}
+
+int take_two(int argc, char **argv) {
+    // Takes the next two arguments, even if they are keys.
+    if (argc < 3) return ARGMAP_EXIT_INVALID_ARG;
+    climap_cout() << "take_two " << argv[1] << ' ' << argv[2] << '\n';
+    return argmap_return_success(argc, 2);
+}
+
+int throw_error(int, char **) {
+    throw std::runtime_error("speculative handler error");
+}
+
+int sequential_calls = 0;
+
+int count_call(int argc, char **) {
+    // Has an effect beyond its output, so must never be called speculatively.
+    ++sequential_calls;
+    return argmap_return_success(argc);
+}
+
+std::thread::id pure_call_thread;
+
+int pure_echo(int argc, char **argv) {
+    pure_call_thread = std::this_thread::get_id();
+    return slow_echo(argc, argv);
+}
+
+int sequential_echo(int argc, char **argv) {
+    climap_cout() << "sequential " << argv[0] << '\n';
+    return argmap_return_success(argc);
+}
+
+int up_calls = 0;
+
+bool is_up_every_other(const char * arg) {
+    // Matches every other "up" it is called on, starting with the second, so tells how often it is called.
+    return std::strcmp(arg, "up") == 0 && up_calls++ % 2 == 1;
+}
+
+int up_matched(int argc, char **) {
+    climap_cout() << "up matched\n";
+    return argmap_return_success(argc);
+}
+
+int up_raw(int argc, char **) {
+    climap_cout() << "up raw\n";
+    return argmap_return_success(argc);
+}
+
+string run(const CLIMap<>& climap, int argc, char **argv, int& result) {
+    CaptureCout capture;
+    result = climap.exec_main(argc, argv);
+    return capture.str();
+}
+
+}
+
+BOOST_AUTO_TEST_CASE(parallel_output_in_command_line_order) {
+    static const CLIMap<> climap {
+        {"echo", climap_speculative(slow_echo)},
+        {"take_two", climap_speculative(take_two)},
+        {"sequential", sequential_echo}
+    };
+    char prog[] = "prog", echo[] = "echo", take[] = "take_two", sequential[] = "sequential", a[] = "a", b[] = "b", c[] = "c";
+    char *argv[] = {prog, echo, a, b, echo, c, sequential, echo, take, echo, a, echo, b, echo};
+    const int argc = sizeof(argv)/sizeof(argv[0]);
+
+    int sequential_result, parallel_result;
+    const string sequential_output = run(climap, argc, argv, sequential_result);
+    string parallel_output;
+    {
+        CLIMapThreadPool pool(4);
+        CLIMapWorkers::install(&pool);
+        parallel_test_most_running = 0;
+        parallel_output = run(climap, argc, argv, parallel_result);
+    }
+    BOOST_TEST(CLIMapWorkers::active() == nullptr);
+    BOOST_TEST(sequential_output == "echo a b\necho c\nsequential sequential\necho\ntake_two echo a\necho b\necho\n");
+    BOOST_TEST(parallel_output == sequential_output);
+    BOOST_TEST(parallel_result == sequential_result);
+    BOOST_TEST(parallel_test_most_running > 1);
+}
+
+BOOST_AUTO_TEST_CASE(parallel_exception) {
+    static const CLIMap<> climap {
+        {"echo", climap_speculative(slow_echo)},
+        {"throw", climap_speculative(throw_error)}
+    };
+    char prog[] = "prog", echo[] = "echo", throw_arg[] = "throw";
+    char *argv[] = {prog, echo, throw_arg, echo};
+    CLIMapThreadPool pool(2);
+    CLIMapWorkers::install(&pool);
+    int result;
+    BOOST_CHECK_THROW(run(climap, 4, argv, result), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(parallel_only_speculative_handlers_launched_ahead) {
+    // take_two is predicted to stop at the first count, but takes it, so only the second is called.
+    static const CLIMap<> climap {
+        {"echo", climap_speculative(slow_echo)},
+        {"take_two", climap_speculative(take_two)},
+        {"count", count_call}
+    };
+    char prog[] = "prog", echo[] = "echo", take[] = "take_two", count[] = "count", a[] = "a";
+    char *argv[] = {prog, echo, a, take, count, a, count};
+    const int argc = sizeof(argv)/sizeof(argv[0]);
+
+    CLIMapThreadPool pool(2);
+    CLIMapWorkers::install(&pool);
+    int result;
+    sequential_calls = 0;
+    BOOST_TEST(run(climap, argc, argv, result) == "echo a\ntake_two count a\n");
+    BOOST_TEST(result == 0);
+    BOOST_TEST(sequential_calls == 1);
+}
+
+BOOST_AUTO_TEST_CASE(parallel_pure_handlers_not_speculative) {
+    // climap_pure alone allows caching, not launching on another thread.
+    static const CLIMap<> climap {
+        {"echo", climap_speculative(slow_echo)},
+        {"pure", climap_pure(pure_echo)}
+    };
+    char prog[] = "prog", echo[] = "echo", pure[] = "pure", a[] = "a";
+    char *argv[] = {prog, echo, a, pure, a, echo};
+    const int argc = sizeof(argv)/sizeof(argv[0]);
+
+    CLIMapThreadPool pool(2);
+    CLIMapWorkers::install(&pool);
+    int result;
+    BOOST_TEST(run(climap, argc, argv, result) == "echo a\npure a\necho\n");
+    BOOST_TEST(result == 0);
+    BOOST_TEST((pure_call_thread == std::this_thread::get_id()));
+}
+
+BOOST_AUTO_TEST_CASE(parallel_matching_functions_called_as_sequentially) {
+    // Looking ahead never calls matching functions, so a stateful one sees the arguments it would sequentially.
+    static const CLIMap<> climap {
+        {is_up_every_other, climap_speculative(up_matched)},
+        {"echo", climap_speculative(slow_echo)},
+        {"up", climap_speculative(up_raw)}
+    };
+    char prog[] = "prog", echo[] = "echo", up[] = "up";
+    char *argv[] = {prog, echo, up, echo, up, echo, up};
+    const int argc = sizeof(argv)/sizeof(argv[0]);
+
+    int sequential_result, parallel_result;
+    up_calls = 0;
+    const string sequential_output = run(climap, argc, argv, sequential_result);
+    BOOST_TEST(sequential_output == "echo\nup raw\necho\nup matched\necho\nup raw\n");
+
+    CLIMapThreadPool pool(4);
+    CLIMapWorkers::install(&pool);
+    up_calls = 0;
+    const string parallel_output = run(climap, argc, argv, parallel_result);
+    BOOST_TEST(parallel_output == sequential_output);
+    BOOST_TEST(parallel_result == sequential_result);
+    BOOST_TEST(up_calls == 3);
+}
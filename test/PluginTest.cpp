@@ -0,0 +1,55 @@
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+#include <stdexcept>
+
+#include "CLIMapPlugin.hpp"
+
+namespace {
+
+CLIMapPlugin<> test_plugin(CLIMAP_TEST_PLUGIN, "climap_test_plugin_main");
+CLIMapPlugin<> test_plugin_calls(CLIMAP_TEST_PLUGIN, "climap_test_plugin_calls");
+CLIMapPlugin<> missing_library("libclimap_no_such_plugin.so", "climap_test_plugin_main");
+CLIMapPlugin<> missing_handler(CLIMAP_TEST_PLUGIN, "climap_no_such_handler");
+
+int plugin_test_tail_calls = 0;
+
+int count_tail(int argc, char **) {
+    ++plugin_test_tail_calls;
+    return argmap_return_success(argc);
+}
+
+}
+
+BOOST_AUTO_TEST_CASE(plugin_loaded_on_first_match) {
+    static const CLIMap<> climap {
+        {"plugin", CLIMapPlugin<>::handler<test_plugin>},
+        {"tail", count_tail}
+    };
+    BOOST_TEST(!test_plugin.loaded());
+
+    char prog[] = "prog", arg1[] = "tail";
+    char *argv_tail[] = {prog, arg1};
+    BOOST_TEST(climap.exec_main(2, argv_tail) == 0);
+    BOOST_TEST(!test_plugin.loaded());
+
+    char arg2[] = "plugin", arg3[] = "take_one", arg4[] = "x";
+    char *argv[] = {prog, arg2, arg3, arg4, arg3, arg4, arg1};
+    BOOST_TEST(climap.exec_main(7, argv) == 0);
+    BOOST_TEST(test_plugin.loaded());
+    BOOST_TEST(plugin_test_tail_calls == 2);
+    BOOST_TEST(CLIMapPlugin<>::handler<test_plugin_calls>(1, argv) == 2);  // The plugin's nested map ran twice.
+}
+
+BOOST_AUTO_TEST_CASE(plugin_not_found) {
+    static const CLIMap<> climap {
+        {"missing_library", CLIMapPlugin<>::handler<missing_library>},
+        {"missing_handler", CLIMapPlugin<>::handler<missing_handler>}
+    };
+    char prog[] = "prog", arg1[] = "missing_library", arg2[] = "missing_handler";
+    char *argv[] = {prog, arg1, arg2};
+    BOOST_CHECK_THROW(climap.exec(2, argv), std::runtime_error);
+    BOOST_CHECK_THROW(climap.exec(2, argv + 1), std::runtime_error);
+    BOOST_TEST(!missing_library.loaded());
+    BOOST_TEST(!missing_handler.loaded());
+}
@@ -0,0 +1,129 @@
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "CLIMap.hpp"
+#include "TestUtil.hpp"
+
+using std::string;
+using std::vector;
+
+namespace {
+
+class FakeProfiler : public CLIMapProfiler {
+    // Checks that phases pair up, and remembers the handlers profiled.
+    public:
+        void begin_phase() override {
+            ++depth;
+            ++phases;
+        }
+
+        void end_matching_phase() override {
+            end_phase();
+        }
+
+        void end_handler_phase(HandlerId handler) override {
+            end_phase();
+            handlers.push_back(handler);
+        }
+
+        int depth = 0;
+        int phases = 0;
+        bool unpaired = false;
+        vector<HandlerId> handlers;
+
+    private:
+        void end_phase() {
+            if (depth == 0) unpaired = true;
+            --depth;
+        }
+};
+
+int profiled_take_one(int argc, char **) {
+    return argmap_return_success(argc);
+}
+
+int profiled_throw(int, char **) {
+    throw std::runtime_error("profiled handler failed");
+}
+
+int profiled_nested(int argc, char **argv) {
+    static const CLIMap<> climap {
+        {"one", profiled_take_one},
+        {"throw", profiled_throw}
+    };
+    return climap.exec(argc, argv);
+}
+
+const CLIMap<>& profiled_map() {
+    static const CLIMap<> climap {
+        {"one", profiled_take_one},
+        {"nested", profiled_nested},
+        {"throw", profiled_throw}
+    };
+    return climap;
+}
+
+int dispatch(vector<string> args) {
+    args.insert(args.begin(), "prog");
+    TestArgv argv(args);
+    return profiled_map().exec_main(argv.argc(), argv.argv());
+}
+
+class InstalledProfiler {
+    public:
+        explicit InstalledProfiler(CLIMapProfiler& profiler) { CLIMapProfiler::install(&profiler); }
+        ~InstalledProfiler() {
+            CLIMapProfiler::deactivate();
+            CLIMapProfiler::install(nullptr);
+        }
+};
+
+}
+
+BOOST_AUTO_TEST_CASE(profile_switch_only_first) {
+    FakeProfiler profiler;
+    InstalledProfiler installed(profiler);
+
+    // Elsewhere, the switch is an argument like any other.
+    BOOST_CHECK_EQUAL(dispatch({"one", "--climap-profile"}), 1);
+    BOOST_CHECK(CLIMapProfiler::active() == nullptr);
+    BOOST_CHECK_EQUAL(profiler.phases, 0);
+
+    BOOST_CHECK_EQUAL(dispatch({"--climap-profile", "one"}), 0);
+    BOOST_CHECK(CLIMapProfiler::active() == &profiler);
+    BOOST_CHECK_EQUAL(profiler.depth, 0);
+    BOOST_CHECK(!profiler.unpaired);
+    BOOST_REQUIRE_EQUAL(profiler.handlers.size(), 1u);
+    BOOST_CHECK(profiler.handlers[0] == reinterpret_cast<CLIMapProfiler::HandlerId>(profiled_take_one));
+}
+
+BOOST_AUTO_TEST_CASE(profile_results_unchanged) {
+    const vector<vector<string>> command_lines {
+        {}, {"one"}, {"one", "one", "bogus"}, {"nested", "one", "one"}, {"nested", "bogus"}, {"one", "nested", "one", "bogus"}
+    };
+    vector<int> unprofiled;
+    for (const vector<string>& args: command_lines) unprofiled.push_back(dispatch(args));
+
+    FakeProfiler profiler;
+    InstalledProfiler installed(profiler);
+    BOOST_CHECK_EQUAL(dispatch({"--climap-profile"}), 1);
+    for (std::size_t i = 0; i != command_lines.size(); ++i) BOOST_CHECK_EQUAL(dispatch(command_lines[i]), unprofiled[i]);
+    BOOST_CHECK_EQUAL(profiler.depth, 0);
+    BOOST_CHECK(!profiler.unpaired);
+    BOOST_CHECK(profiler.phases > 0);
+}
+
+BOOST_AUTO_TEST_CASE(profile_phases_paired_on_throw) {
+    FakeProfiler profiler;
+    InstalledProfiler installed(profiler);
+    BOOST_CHECK_THROW(dispatch({"--climap-profile", "one", "throw"}), std::runtime_error);
+    BOOST_CHECK_EQUAL(profiler.depth, 0);
+    BOOST_CHECK_THROW(dispatch({"nested", "one", "throw"}), std::runtime_error);
+    BOOST_CHECK_EQUAL(profiler.depth, 0);
+    BOOST_CHECK(!profiler.unpaired);
+    BOOST_CHECK(profiler.handlers.back() == reinterpret_cast<CLIMapProfiler::HandlerId>(profiled_nested));
+}
@@ -0,0 +1,60 @@
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include "CLIMapRecord.hpp"
+
+using std::string;
+using std::vector;
+
+namespace {
+
+int record_test_handled = 0;
+
+int count_handled(int argc, char **) {
+    ++record_test_handled;
+    return argmap_return_success(argc);
+}
+
+}
+
+BOOST_AUTO_TEST_CASE(record_and_replay_round_trip) {
+    const CLIMap<> climap {
+        {"repeat", count_handled},
+        {"a_key_longer_than_eight", count_handled}
+    };
+    char path[] = "/tmp/climap_record_test_XXXXXX";
+    int fd = mkstemp(path);
+    BOOST_REQUIRE(fd != -1);
+    close(fd);
+
+    char prog[] = "prog", arg1[] = "repeat", arg2[] = "a_key_longer_than_eight";
+    char *argv_1[] = {prog, arg1, arg1, nullptr};
+    char *argv_2[] = {prog, arg2, arg1, nullptr};
+    {
+        CLIMapLogRecorder recorder(path);
+        CLIMapRecorder::install(&recorder);
+        climap.exec_main(3, argv_1);
+        climap.exec_main(3, argv_2, 1);
+    }
+    climap.exec_main(3, argv_1);    // No longer recorded.
+
+    CLIMapReplayLog log(path);
+    std::remove(path);
+    const auto& commands = log.get_commands();
+    BOOST_REQUIRE(commands.size() == 2u);
+    BOOST_TEST(commands[0].args_to_skip == 0);
+    BOOST_TEST(commands[1].args_to_skip == 1);
+    BOOST_TEST(vector<string>(commands[1].argv.begin(), commands[1].argv.end() - 1) == (vector<string>{"prog", "a_key_longer_than_eight", "repeat"}), boost::test_tools::per_element());
+    BOOST_TEST(commands[1].argv.back() == nullptr);
+
+    record_test_handled = 0;
+    auto report = climap_replay(log, [&climap](int argc, char **argv, int args_to_skip) { return climap.exec_main(argc, argv, args_to_skip); });
+    BOOST_TEST(report.commands == 2u);
+    BOOST_TEST(record_test_handled == 3);
+}
@@ -0,0 +1,237 @@
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "CLIMap.hpp"
+#include "CLIMapOutput.hpp"
+#include "CLIMapResultCache.hpp"
+#include "TestUtil.hpp"
+
+using std::string;
+using std::vector;
+
+namespace {
+
+int result_cache_calls = 0;
+
+int echo_args(int argc, char **argv) {
+    // Prints and takes its arguments up to "stop" or "echo", but not "next".
+    ++result_cache_calls;
+    int taken = 0;
+    while (taken + 1 < argc && string(argv[taken + 1]) != "stop" && string(argv[taken + 1]) != "echo") {
+        climap_cout() << argv[taken + 1] << ' ';
+        ++taken;
+    }
+    climap_cout() << '\n';
+    return argmap_return_success(argc, taken);
+}
+
+int take_none(int argc, char **) {
+    return argmap_return_success(argc);
+}
+
+const CLIMap<>& result_cache_map() {
+    static const CLIMap<> climap {
+        {"echo", climap_pure(echo_args)},
+        {"stop", take_none},
+        {"next", take_none}
+    };
+    return climap;
+}
+
+string dispatch(vector<string> args) {
+    args.insert(args.begin(), "prog");
+    TestArgv argv(args);
+    CaptureCout capture;
+    result_cache_map().exec_main(argv.argc(), argv.argv());
+    return capture.str();
+}
+
+class TemporaryPath {
+    public:
+        TemporaryPath() {
+            char path_template[] = "/tmp/climap_result_cache_test_XXXXXX";
+            const int fd = mkstemp(path_template);
+            if (fd != -1) close(fd);
+            path = path_template;
+            std::remove(path.c_str());  // The cache creates it.
+        }
+        ~TemporaryPath() { std::remove(path.c_str()); }
+
+        string path;
+};
+
+string stress_value(int key, int writer, int version) {
+    // A value that can be told from every other and from any mix of them, of a length that varies.
+    string value = std::to_string(key) + ' ' + std::to_string(writer) + ' ' + std::to_string(version) + ':';
+    const int body_length = (version*7 + writer*3 + key) % 150;
+    for (int i = 0; i != body_length; ++i) value += static_cast<char>('a' + (key*31 + writer*17 + version*13 + i) % 26);
+    return value;
+}
+
+bool is_stress_value(int key, const string& value) {
+    int value_key, writer, version;
+    if (std::sscanf(value.c_str(), "%d %d %d:", &value_key, &writer, &version) != 3) return false;
+    return value_key == key && value == stress_value(key, writer, version);
+}
+
+int stress_cache(const char * path, int writer) {
+    // Inserts and finds overlapping keys, in a child process, returning the number of bad hits.
+    CLIMapMappedResultCache cache(path, 16, 256);
+    int bad_hits = 0;
+    string output;
+    for (int version = 0; version != 200000; ++version) {    // Long enough to be preempted mid copy on one core.
+        const int key = (version*7 + writer) % 24;
+        CLIMapResultCache::Key cache_key;
+        cache_key.add(static_cast<std::uint64_t>(key));
+        if (cache.find(cache_key, output) && !is_stress_value(key, output)) ++bad_hits;
+        if (version % 3 == writer % 3) cache.insert(cache_key, stress_value(key, writer, version));
+    }
+    return bad_hits;
+}
+
+class Installed {
+    public:
+        explicit Installed(CLIMapResultCache& cache) { CLIMapResultCache::install(&cache); }
+        ~Installed() { CLIMapResultCache::install(nullptr); }
+};
+
+}
+
+BOOST_AUTO_TEST_CASE(result_cache_shared_between_mappings) {
+    TemporaryPath file;
+    {
+        CLIMapMappedResultCache cache(file.path.c_str());
+        Installed installed(cache);
+        result_cache_calls = 0;
+        BOOST_CHECK_EQUAL(dispatch({"echo", "a", "b", "stop", "echo", "c"}), "a b \nc \n");
+        BOOST_CHECK_EQUAL(result_cache_calls, 2);
+    }
+
+    // As another process would, with the same handler output and no calls.
+    CLIMapMappedResultCache cache(file.path.c_str());
+    Installed installed(cache);
+    result_cache_calls = 0;
+    BOOST_CHECK_EQUAL(dispatch({"stop", "echo", "c", "echo", "a", "b"}), "c \na b \n");
+    BOOST_CHECK_EQUAL(result_cache_calls, 0);
+
+    // Other arguments and formats are other entries.
+    BOOST_CHECK_EQUAL(dispatch({"echo", "a", "c"}), "a c \n");
+    BOOST_CHECK_EQUAL(result_cache_calls, 1);
+    {
+        TestArgv argv({"prog", "echo", "c"});
+        CaptureCout capture;
+        result_cache_map().exec_main(argv.argc(), argv.argv(), CLIMapOutputFormat::ndjson);
+    }
+    BOOST_CHECK_EQUAL(result_cache_calls, 2);
+}
+
+BOOST_AUTO_TEST_CASE(result_cache_only_stores_predicted_calls) {
+    TemporaryPath file;
+    CLIMapMappedResultCache cache(file.path.c_str());
+    Installed installed(cache);
+    result_cache_calls = 0;
+
+    // echo is predicted to stop before "next", another key, but takes it, so is called every time.
+    BOOST_CHECK_EQUAL(dispatch({"echo", "a", "next", "b"}), "a next b \n");
+    BOOST_CHECK_EQUAL(dispatch({"echo", "a", "next", "b"}), "a next b \n");
+    BOOST_CHECK_EQUAL(result_cache_calls, 2);
+    BOOST_CHECK_EQUAL(dispatch({"echo", "a", "stop", "next"}), "a \n");
+    BOOST_CHECK_EQUAL(dispatch({"echo", "a", "stop"}), "a \n");
+    BOOST_CHECK_EQUAL(result_cache_calls, 3);
+}
+
+BOOST_AUTO_TEST_CASE(result_cache_limits) {
+    TemporaryPath file;
+    CLIMapMappedResultCache cache(file.path.c_str(), 4, 64);
+    BOOST_CHECK_EQUAL(cache.slot_count(), 4u);
+    BOOST_CHECK_EQUAL(cache.max_output_size(), 24u);
+    Installed installed(cache);
+    result_cache_calls = 0;
+
+    // Too long to cache.
+    dispatch({"echo", "0123456789", "0123456789", "0123456789"});
+    dispatch({"echo", "0123456789", "0123456789", "0123456789"});
+    BOOST_CHECK_EQUAL(result_cache_calls, 2);
+
+    // Four slots hold four entries, and a fifth evicts the least recently used, the first.
+    result_cache_calls = 0;
+    for (const char * arg: {"1", "2", "3", "4", "2", "3", "4", "5"}) dispatch({"echo", arg});
+    BOOST_CHECK_EQUAL(result_cache_calls, 5);
+    dispatch({"echo", "2"});
+    dispatch({"echo", "5"});
+    BOOST_CHECK_EQUAL(result_cache_calls, 5);
+    dispatch({"echo", "1"});
+    BOOST_CHECK_EQUAL(result_cache_calls, 6);
+}
+
+BOOST_AUTO_TEST_CASE(result_cache_rejects_other_files) {
+    TemporaryPath file;
+    {
+        std::ofstream out(file.path);
+        out << "fizzbuzz 15\n";
+    }
+    BOOST_CHECK_THROW(CLIMapMappedResultCache cache(file.path.c_str()), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(result_cache_recreates_zeroed_header) {
+    // As left by a process that died between sizing the file and writing its header.
+    TemporaryPath file;
+    {
+        std::ofstream out(file.path, std::ios::binary);
+        out << string(1000, '\0');
+    }
+    {
+        CLIMapMappedResultCache cache(file.path.c_str(), 8, 64);
+        BOOST_CHECK_EQUAL(cache.slot_count(), 8u);
+    }
+    CLIMapMappedResultCache cache(file.path.c_str());
+    BOOST_CHECK_EQUAL(cache.slot_count(), 8u);
+}
+
+BOOST_AUTO_TEST_CASE(result_cache_concurrent_processes) {
+    // Processes creating the same cache at once, then inserting and finding the same few keys, only
+    // ever find values that were inserted, whole.
+    TemporaryPath file;
+    const int children = 4;
+    vector<pid_t> pids;
+    for (int writer = 0; writer != children; ++writer) {
+        const pid_t pid = fork();
+        BOOST_REQUIRE(pid != -1);
+        if (pid == 0) {
+            int bad_hits = 1;
+            try {
+                bad_hits = stress_cache(file.path.c_str(), writer);
+            } catch (...) { }
+            std::_Exit(bad_hits == 0 ? 0 : 1);
+        }
+        pids.push_back(pid);
+    }
+    for (pid_t pid: pids) {
+        int status;
+        BOOST_REQUIRE(waitpid(pid, &status, 0) == pid);
+        BOOST_CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    }
+
+    CLIMapMappedResultCache cache(file.path.c_str());
+    BOOST_CHECK_EQUAL(cache.slot_count(), 16u);
+    int hits = 0;
+    string output;
+    for (int key = 0; key != 24; ++key) {
+        CLIMapResultCache::Key cache_key;
+        cache_key.add(static_cast<std::uint64_t>(key));
+        if (!cache.find(cache_key, output)) continue;
+        ++hits;
+        BOOST_CHECK(is_stress_value(key, output));
+    }
+    BOOST_CHECK(hits > 0);
+}
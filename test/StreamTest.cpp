@@ -0,0 +1,167 @@
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <string>
+#include <thread>
+
+#include <unistd.h>
+
+#include "CLIMapArgStream.hpp"
+
+using std::string;
+
+namespace {
+
+using StreamMap = CLIMap<const char*, CLIMapDT::MatchFnType, CLIMapArgStream::iterator>;
+
+long stream_test_sum = 0;
+std::size_t stream_test_most_buffered = 0;
+CLIMapArgStream * stream_test_args = nullptr;
+std::atomic<bool> stream_test_marked{false};
+bool stream_test_noarg = false;
+
+int add(int argc, CLIMapArgStream::iterator argv) {
+    if (argv[1] == nullptr) return ARGMAP_EXIT_INVALID_ARG;
+    stream_test_sum += std::atol(argv[1]);
+    if (stream_test_args->buffered() > stream_test_most_buffered) stream_test_most_buffered = stream_test_args->buffered();
+    return argmap_return_success(argc, 1);
+}
+
+int mark(int argc, CLIMapArgStream::iterator) {
+    stream_test_marked = true;
+    return argmap_return_success(argc);
+}
+
+int sub_noarg(int argc, CLIMapArgStream::iterator) {
+    stream_test_noarg = true;
+    return argmap_return_success(argc);
+}
+
+int sub(int argc, CLIMapArgStream::iterator argv) {
+    static const StreamMap climap {
+        {"add", add},
+        {noarg, sub_noarg}
+    };
+    return climap.exec(argc, argv);
+}
+
+const StreamMap& stream_test_map() {
+    static const StreamMap climap {
+        {"add", add},
+        {"mark", mark},
+        {"sub", sub}
+    };
+    return climap;
+}
+
+void write_all(int fd, const string& text) {
+    std::size_t written = 0;
+    while (written != text.size()) {
+        const ssize_t count = ::write(fd, text.data() + written, text.size() - written);
+        if (count <= 0) return;
+        written += count;
+    }
+}
+
+int exec_on(const string& input, char separator = '\n') {
+    int fds[2];
+    BOOST_TEST_REQUIRE(::pipe(fds) == 0);
+    std::thread writer([&] {
+        write_all(fds[1], input);
+        ::close(fds[1]);
+    });
+    CLIMapArgStream args(fds[0], "prog", separator);
+    stream_test_args = &args;
+    const int result = stream_test_map().exec_main(CLIMAP_UNBOUNDED_ARGC, args.begin());
+    writer.join();
+    ::close(fds[0]);
+    return result;
+}
+
+}
+
+BOOST_AUTO_TEST_CASE(stream_dispatch_in_constant_memory) {
+    int fds[2];
+    BOOST_TEST_REQUIRE(::pipe(fds) == 0);
+    const int adds = 200000;
+    std::thread writer([&] {
+        string chunk;
+        for (int i = 1; i <= adds; ++i) {
+            chunk += "add\n" + std::to_string(i) + "\n";
+            if (chunk.size() > 4096) {
+                write_all(fds[1], chunk);
+                chunk.clear();
+            }
+        }
+        write_all(fds[1], chunk);
+        ::close(fds[1]);
+    });
+    const std::size_t window = 16;
+    CLIMapArgStream args(fds[0], "prog", '\n', window);
+    stream_test_args = &args;
+    stream_test_sum = 0;
+    stream_test_most_buffered = 0;
+    BOOST_TEST(stream_test_map().exec_main(CLIMAP_UNBOUNDED_ARGC, args.begin()) == 0);
+    writer.join();
+    ::close(fds[0]);
+    BOOST_TEST(stream_test_sum == static_cast<long>(adds)*(adds + 1)/2);
+    BOOST_TEST(stream_test_most_buffered <= window);
+}
+
+BOOST_AUTO_TEST_CASE(stream_dispatch_before_input_ends) {
+    // The writer only finishes once "mark" has been handled.
+    int fds[2];
+    BOOST_TEST_REQUIRE(::pipe(fds) == 0);
+    stream_test_marked = false;
+    bool marked_before_end = false;
+    std::thread writer([&] {
+        write_all(fds[1], "mark\n");
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+        while (!stream_test_marked && std::chrono::steady_clock::now() < deadline) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        marked_before_end = stream_test_marked;
+        write_all(fds[1], "add\n5\n");
+        ::close(fds[1]);
+    });
+    CLIMapArgStream args(fds[0], "prog");
+    stream_test_args = &args;
+    stream_test_sum = 0;
+    BOOST_TEST(stream_test_map().exec_main(CLIMAP_UNBOUNDED_ARGC, args.begin()) == 0);
+    writer.join();
+    ::close(fds[0]);
+    BOOST_TEST(marked_before_end);
+    BOOST_TEST(stream_test_sum == 5);
+}
+
+BOOST_AUTO_TEST_CASE(stream_end_of_args) {
+    stream_test_sum = 0;
+    stream_test_noarg = false;
+    BOOST_TEST(exec_on(string("add\0" "2\0" "sub\0" "add\0" "3", 15), '\0') == 0);
+    BOOST_TEST(stream_test_sum == 5);
+    BOOST_TEST(!stream_test_noarg);
+
+    BOOST_TEST(exec_on("add\n1\nsub\n") == 0);    // sub at the end gets noarg.
+    BOOST_TEST(stream_test_noarg);
+
+    BOOST_TEST(exec_on("") == CLIMAP_UNBOUNDED_ARGC);    // As argc is 1 for no arguments.
+    BOOST_TEST(exec_on("add\n") == ARGMAP_EXIT_INVALID_ARG);
+
+    // An unrecognised argument leaves the count from it to CLIMAP_UNBOUNDED_ARGC.
+    BOOST_TEST(exec_on("add\n1\nbogus\nadd\n2\n") == CLIMAP_UNBOUNDED_ARGC - 3);
+}
+
+BOOST_AUTO_TEST_CASE(stream_window) {
+    int fds[2];
+    BOOST_TEST_REQUIRE(::pipe(fds) == 0);
+    write_all(fds[1], "a\nb\nc\n");
+    ::close(fds[1]);
+    CLIMapArgStream args(fds[0], "prog", '\n', 2);
+    CLIMapArgStream::iterator argv = args.begin();
+    BOOST_TEST(string(argv[1]) == "a");
+    BOOST_TEST(string(argv[3]) == "c");
+    BOOST_TEST(argv[4] == nullptr);
+    BOOST_CHECK_THROW(argv[1], std::out_of_range);
+    ::close(fds[0]);
+}
@@ -0,0 +1,28 @@
+// Built as a shared object and loaded lazily by PluginTest.cpp.
+
+#include "CLIMap.hpp"
+
+namespace {
+
+int plugin_calls = 0;
+
+int plugin_take_one(int argc, char **) {
+    ++plugin_calls;
+    return argmap_return_success(argc, 1);
+}
+
+}
+
+extern "C" int climap_test_plugin_main(int argc, char **argv) {
+    // A nested map brought by the plugin.
+    static const CLIMap<> climap {
+        {"take_one", plugin_take_one}
+    };
+    return climap.exec(argc, argv);
+}
+
+extern "C" int climap_test_plugin_calls(int argc, char **) {
+    // Reports the calls so far as its "number of arguments left", for the test to check.
+    (void) argc;
+    return plugin_calls;
+}
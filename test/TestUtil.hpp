@@ -0,0 +1,46 @@
+#ifndef CLIMAP_TEST_UTIL_HEADER_GUARD
+#define CLIMAP_TEST_UTIL_HEADER_GUARD
+
+// Fixtures shared by the tests.
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+class CaptureCout {
+    // Takes what is written to std::cout, and so what handlers print, while in scope.
+    public:
+        CaptureCout(): cout_buffer{std::cout.rdbuf(out.rdbuf())} { }
+        ~CaptureCout() { std::cout.rdbuf(cout_buffer); }
+        CaptureCout(const CaptureCout&) = delete;
+        CaptureCout& operator=(const CaptureCout&) = delete;
+
+        std::string str() const { return out.str(); }
+
+    private:
+        std::ostringstream out;
+        std::streambuf * cout_buffer;
+};
+
+class TestArgv {
+    // A mutable argv over copies of args, null terminated as main's is. Neither copied nor moved, as
+    // argv points into the copies.
+    public:
+        explicit TestArgv(std::vector<std::string> args_in): args(std::move(args_in)) {
+            for (std::string& arg: args) pointers.push_back(&arg[0]);
+            pointers.push_back(nullptr);
+        }
+        TestArgv(const TestArgv&) = delete;
+        TestArgv& operator=(const TestArgv&) = delete;
+
+        int argc() const { return static_cast<int>(args.size()); }
+        char ** argv() { return pointers.data(); }
+
+    private:
+        std::vector<std::string> args;
+        std::vector<char *> pointers;
+};
+
+#endif
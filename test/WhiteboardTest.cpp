@@ -0,0 +1,41 @@
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "TestUtil.hpp"
+#include "whiteboard_main.hpp"
+
+using std::string;
+using std::vector;
+
+namespace {
+
+string whiteboard_output(vector<string> args) {
+    args.insert(args.begin(), "whiteboard");
+    TestArgv argv(args);
+    CaptureCout capture;
+    whiteboard_main(argv.argc(), argv.argv());
+    return capture.str();
+}
+
+}
+
+BOOST_AUTO_TEST_CASE(whiteboard_fib_seeds_carry_over) {
+    // f0 and f1 stay set for later fib commands in the same run, as they always have.
+    BOOST_CHECK_EQUAL(whiteboard_output({"fib", "f0", "5", "3", "fib", "3"}), "7\n7\n");
+    BOOST_CHECK_EQUAL(whiteboard_output({"fib", "f0", "0", "f1", "1", "3", "fact", "3", "fib", "4"}), "2\n6\n3\n");
+}
+
+BOOST_AUTO_TEST_CASE(whiteboard_help_in_each_format) {
+    const string text = whiteboard_output({"help"});
+    BOOST_CHECK_EQUAL(text.substr(0, 46), "whiteboard [--ndjson | --binary] <command>...\n");
+
+    // A single record, rather than lines of text among the records.
+    const string ndjson = whiteboard_output({"--ndjson", "help"});
+    BOOST_CHECK_EQUAL(ndjson.substr(0, 94), "{\"type\":\"result\",\"command\":\"help\",\"value\":\"whiteboard [--ndjson | --binary] <command>...\\u000a");
+    BOOST_CHECK_EQUAL(std::count(ndjson.begin(), ndjson.end(), '\n'), 1);
+    BOOST_CHECK_EQUAL(whiteboard_output({"--ndjson"}), ndjson);
+}